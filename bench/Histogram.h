@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/// Log-linear latency histogram in the style of HdrHistogram.
+///
+/// Values below 2^SUB_BUCKET_BITS are recorded exactly. Larger values are
+/// grouped into power-of-two ranges, each split into 2^(SUB_BUCKET_BITS - 1)
+/// linear sub-buckets, which keeps 3 significant decimal digits. Values above
+/// MAX_VALUE are clamped. Not thread safe.
+class Histogram {
+public:
+    static constexpr const unsigned SUB_BUCKET_BITS = 11;
+    static constexpr const unsigned MAX_VALUE_BITS  = 42;
+    static constexpr const uint64_t MAX_VALUE =
+        (uint64_t(1) << MAX_VALUE_BITS) - 1;
+
+    Histogram()
+        : m_counts(IndexOf(MAX_VALUE) + 1),
+          m_total(0),
+          m_sum(0),
+          m_min(MAX_VALUE),
+          m_max(0) {}
+
+    void Record(uint64_t value) noexcept {
+        value = (value > MAX_VALUE) ? MAX_VALUE : value;
+        m_counts[IndexOf(value)] += 1;
+        m_total += 1;
+        m_sum += static_cast<double>(value);
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+    }
+
+    void Merge(const Histogram &other) noexcept {
+        for (size_t i = 0; i < m_counts.size(); ++i)
+            m_counts[i] += other.m_counts[i];
+        m_total += other.m_total;
+        m_sum += other.m_sum;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+    }
+
+    uint64_t Count() const noexcept { return m_total; }
+    uint64_t Min() const noexcept { return (m_total == 0) ? 0 : m_min; }
+    uint64_t Max() const noexcept { return m_max; }
+
+    double Mean() const noexcept {
+        return (m_total == 0) ? 0 : m_sum / static_cast<double>(m_total);
+    }
+
+    /// Highest value equivalent to the value at @p percentile (0 - 100).
+    uint64_t ValueAt(double percentile) const noexcept {
+        if (m_total == 0)
+            return 0;
+
+        auto rank = static_cast<uint64_t>(
+            std::ceil(percentile / 100.0 * static_cast<double>(m_total)));
+        rank      = std::max<uint64_t>(rank, 1);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < m_counts.size(); ++i) {
+            seen += m_counts[i];
+            if (seen >= rank)
+                return std::min(HighestEquivalent(i), m_max);
+        }
+        return m_max;
+    }
+
+private:
+    static constexpr const uint64_t SUB_BUCKET_COUNT = uint64_t(1)
+                                                       << SUB_BUCKET_BITS;
+    static constexpr const uint64_t SUB_BUCKET_HALF = SUB_BUCKET_COUNT / 2;
+
+    static unsigned Log2(uint64_t value) noexcept {
+        return 63 - static_cast<unsigned>(__builtin_clzll(value));
+    }
+
+    static size_t IndexOf(uint64_t value) noexcept {
+        if (value < SUB_BUCKET_COUNT)
+            return static_cast<size_t>(value);
+
+        unsigned shift = Log2(value) - (SUB_BUCKET_BITS - 1);
+        uint64_t sub   = (value >> shift) - SUB_BUCKET_HALF;
+        return static_cast<size_t>(SUB_BUCKET_COUNT +
+                                   (shift - 1) * SUB_BUCKET_HALF + sub);
+    }
+
+    static uint64_t HighestEquivalent(size_t index) noexcept {
+        if (index < SUB_BUCKET_COUNT)
+            return index;
+
+        uint64_t offset = index - SUB_BUCKET_COUNT;
+        unsigned shift  = static_cast<unsigned>(offset / SUB_BUCKET_HALF) + 1;
+        uint64_t sub    = offset % SUB_BUCKET_HALF + SUB_BUCKET_HALF;
+        return ((sub + 1) << shift) - 1;
+    }
+
+private:
+    std::vector<uint64_t> m_counts;
+    uint64_t              m_total;
+    double                m_sum;
+    uint64_t              m_min;
+    uint64_t              m_max;
+};
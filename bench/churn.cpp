@@ -0,0 +1,157 @@
+/// Connection churn benchmark.
+///
+/// Client threads repeatedly connect, exchange one byte and reset the
+/// connection, so the server keeps creating and destroying connection objects.
+/// Reports connections per second and connection pool hits.
+#include "eveio/TcpServer.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace eveio;
+
+struct Options {
+    size_t seconds  = 10;
+    size_t clients  = 4;
+    size_t loops    = 2;
+    bool   use_pool = true;
+};
+
+static void Usage(const char *name) {
+    printf("Usage: %s [-t seconds] [-c clients] [-l loops] [-n]\n"
+           "  -t  Benchmark duration in seconds. Default 10.\n"
+           "  -c  Number of client threads. Default 4.\n"
+           "  -l  Number of server worker loops. Default 2.\n"
+           "  -n  Disable connection object recycling.\n",
+           name);
+}
+
+static void RunClient(const InetAddr          &addr,
+                      const std::atomic_bool  &is_quit,
+                      std::atomic<uint64_t>   &num_failed) {
+    struct linger reset = {1, 0};
+    char          byte  = 'x';
+
+    while (!is_quit.load(std::memory_order_relaxed)) {
+        TcpConnection conn(addr);
+        if (!conn.IsValid() || conn.Send(&byte, 1) != 1 ||
+            conn.Receive(&byte, 1) != 1) {
+            num_failed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        // Reset instead of close to keep ports out of TIME_WAIT.
+        ::setsockopt(conn.GetSocket(), SOL_SOCKET, SO_LINGER, &reset,
+                     sizeof(reset));
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "t:c:l:nh")) != -1) {
+        switch (opt) {
+        case 't':
+            options.seconds = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'c':
+            options.clients = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'l':
+            options.loops = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'n':
+            options.use_pool = false;
+            break;
+        default:
+            Usage(argv[0]);
+            return -10;
+        }
+    }
+
+    EventLoop loop;
+    auto      pool = std::make_shared<EventLoopThreadPool>(options.loops);
+    TcpServer server(loop, InetAddr::Ipv4Loopback(0), pool);
+
+    std::atomic<uint64_t> num_closed{0};
+    server.SetMessageCallback(
+        [](AsyncTcpConnection *conn, AsyncTcpConnBuffer &buffer) {
+            conn->AsyncSend(buffer.Data<char>(), buffer.Size());
+            buffer.Clear();
+        });
+    server.SetCloseCallback([&num_closed](AsyncTcpConnection *) {
+        num_closed.fetch_add(1, std::memory_order_relaxed);
+    });
+    server.Start();
+
+    InetAddr addr;
+    if (!server.GetLocalAddr(addr)) {
+        fprintf(stderr, "Failed to get server address.\n");
+        return -1;
+    }
+
+    if (!options.use_pool) {
+        for (EventLoop *worker : pool->GetAllLoops()) {
+            worker->RunInLoop(
+                [worker]() { worker->GetConnectionPool().SetCacheLimit(0); });
+        }
+    }
+
+    std::atomic_bool         is_quit{false};
+    std::atomic<uint64_t>    num_failed{0};
+    std::vector<std::thread> clients;
+    for (size_t i = 0; i < options.clients; ++i) {
+        clients.emplace_back(
+            [&]() { RunClient(addr, is_quit, num_failed); });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread timer([&]() {
+        std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+        is_quit.store(true, std::memory_order_relaxed);
+        for (auto &client : clients)
+            client.join();
+        loop.Quit();
+    });
+
+    loop.Loop();
+    timer.join();
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    // Collect pool statistics in each worker thread.
+    uint64_t num_acquired     = 0;
+    uint64_t num_system_alloc = 0;
+    for (EventLoop *worker : pool->GetAllLoops()) {
+        std::promise<ObjectPoolStats> stats;
+        worker->RunInLoop([worker, &stats]() {
+            stats.set_value(worker->GetConnectionPool().GetStats());
+        });
+
+        ObjectPoolStats result = stats.get_future().get();
+        num_acquired += result.num_acquired;
+        num_system_alloc += result.num_system_alloc;
+    }
+
+    uint64_t closed = num_closed.load(std::memory_order_relaxed);
+    printf("connection pool:     %s\n", options.use_pool ? "on" : "off");
+    printf("connections closed:  %llu\n",
+           static_cast<unsigned long long>(closed));
+    printf("connections/sec:     %.0f\n", closed / elapsed.count());
+    printf("failed connects:     %llu\n",
+           static_cast<unsigned long long>(num_failed.load()));
+    printf("objects acquired:    %llu\n",
+           static_cast<unsigned long long>(num_acquired));
+    printf("system allocations:  %llu\n",
+           static_cast<unsigned long long>(num_system_alloc));
+    return 0;
+}
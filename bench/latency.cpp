@@ -0,0 +1,562 @@
+/// Open-loop latency benchmark.
+///
+/// Requests are sent at a constant total rate spread over all connections,
+/// whether or not earlier responses have arrived. The target must echo every
+/// byte back, like example/echo.cpp or the built-in echo server used when no
+/// port is given. Requests on one connection are answered in order, so each
+/// response is matched with the oldest request in flight.
+///
+/// Latency is measured from the time a request was scheduled to be sent, not
+/// from the time it was actually sent. A stalled server or a late generator
+/// therefore cannot hide the requests it delayed (coordinated omission). The
+/// uncorrected service time, measured from the real send time, is reported
+/// as well. Requests still unanswered when the benchmark ends are recorded
+/// with the time waited so far.
+///
+/// On Linux, each client loop wakes up at the exact send time of the next
+/// request with an absolute timerfd and a minimal timer slack, so corrected
+/// latency reflects the server rather than the pacing of the generator.
+/// Elsewhere sending is paced by a 1ms loop timer, and corrected latency
+/// includes up to about one tick of pacing delay.
+#include "Histogram.h"
+
+#include "eveio/TcpServer.h"
+
+#include <unistd.h>
+
+#if EVEIO_OS_LINUX
+#    include <sys/prctl.h>
+#    include <sys/timerfd.h>
+#endif
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef EVEIO_VERSION
+#    define EVEIO_VERSION "unknown"
+#endif
+
+using namespace eveio;
+
+struct Options {
+    double      rate         = 10000;
+    size_t      connections  = 100;
+    size_t      payload_size = 64;
+    size_t      seconds      = 10;
+    size_t      warmup       = 1;
+    size_t      client_loops = 2;
+    size_t      server_loops = 2;
+    std::string ip           = "127.0.0.1";
+    uint16_t    port         = 0;
+    std::string unix_path;
+    bool        json         = false;
+};
+
+static void Usage(const char *name) {
+    printf("Usage: %s [-r rate] [-c connections] [-s size] [-t seconds] "
+           "[-w seconds] [-l loops] [-a ip] [-p port] [-u path] [-S loops] "
+           "[-j]\n"
+           "  -r  Total requests per second. Default 10000.\n"
+           "  -c  Number of connections. Default 100.\n"
+           "  -s  Request payload size in bytes. Default 64.\n"
+           "  -t  Measured duration in seconds. Default 10.\n"
+           "  -w  Warm up seconds excluded from results. Default 1.\n"
+           "  -l  Number of client loops. Default 2.\n"
+           "  -a  Target IP address. Default 127.0.0.1.\n"
+           "  -p  Target port. Start a built-in echo server if not set.\n"
+           "  -u  Run the built-in echo server on an AF_UNIX socket at path\n"
+           "      instead of TCP loopback. '@' prefix for abstract names.\n"
+           "  -S  Worker loops of the built-in echo server. Default 2.\n"
+           "  -j  Print result as one JSON line.\n",
+           name);
+}
+
+static int64_t NowNanos() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// Load generator of one client loop. Except for construction, all methods
+/// must be called in the loop thread.
+class Generator {
+public:
+    Generator(EventLoop &loop, std::shared_ptr<const std::string> payload)
+        : m_loop(&loop),
+          m_payload(std::move(payload)),
+          m_sessions(),
+          m_schedule(),
+          m_interval(0),
+          m_measure_from(0),
+          m_stop_at(0),
+          m_timer(0),
+          m_timer_fd(-1),
+          m_pacer(),
+          m_num_sent(0),
+          m_num_completed(0),
+          m_num_unanswered(0),
+          m_corrected(),
+          m_uncorrected() {}
+
+    void AddConnection(socket_t sock) {
+        std::unique_ptr<Session> session(new Session);
+        Session *s = session.get();
+
+        s->conn = AsyncTcpConnection::Create(*m_loop, TcpConnection(sock));
+        s->conn->SetNoDelay(true);
+        s->conn->SetMessageCallback(
+            [this, s](AsyncTcpConnection *, AsyncTcpConnBuffer &buffer) {
+                this->HandleResponse(*s, buffer);
+            });
+        s->conn->SetCloseCallback(
+            [s](AsyncTcpConnection *) { s->conn = nullptr; });
+
+        m_sessions.push_back(std::move(session));
+    }
+
+    /// Connection @p first_index of this loop sends its first request at
+    /// @p start. Other connections are spread evenly over @p interval.
+    void Start(int64_t start,
+               int64_t interval,
+               size_t  first_index,
+               size_t  total_connections,
+               int64_t measure_from,
+               int64_t stop_at) {
+        m_interval     = interval;
+        m_measure_from = measure_from;
+        m_stop_at      = stop_at;
+
+        for (size_t i = 0; i < m_sessions.size(); ++i) {
+            auto offset = static_cast<double>(interval) *
+                          static_cast<double>(first_index + i) /
+                          static_cast<double>(total_connections);
+            m_sessions[i]->next_send = start + static_cast<int64_t>(offset);
+            if (m_sessions[i]->next_send < m_stop_at)
+                m_schedule.push(Due{m_sessions[i]->next_send, i});
+        }
+
+#if EVEIO_OS_LINUX
+        // The default 50us slack of the thread would delay every wake up.
+        ::prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+        m_timer_fd = ::timerfd_create(CLOCK_MONOTONIC,
+                                      TFD_NONBLOCK | TFD_CLOEXEC);
+        if (m_timer_fd >= 0) {
+            m_pacer.reset(new Listener(*m_loop, m_timer_fd));
+            m_pacer->TieObject(this);
+            m_pacer->SetReadCallback(+[](Listener *listener) {
+                auto generator =
+                    static_cast<Generator *>(listener->GetTiedObject());
+                generator->HandlePacer();
+            });
+            m_pacer->EnableReading();
+            ArmPacer();
+            return;
+        }
+#endif
+
+        m_timer = m_loop->RunEvery(std::chrono::milliseconds(1),
+                                   [this]() { this->SendDue(); });
+    }
+
+    /// Stop sending, record unanswered requests and close all connections.
+    void Finish() {
+        if (m_pacer) {
+            m_pacer->DisableAll();
+            m_pacer->Unregister();
+            m_pacer.reset();
+            ::close(m_timer_fd);
+            m_timer_fd = -1;
+        } else {
+            m_loop->CancelTimer(m_timer);
+        }
+
+        int64_t now = NowNanos();
+        for (const auto &session : m_sessions) {
+            for (const Request &request : session->in_flight) {
+                if (request.scheduled >= m_measure_from) {
+                    Record(request, now);
+                    m_num_unanswered += 1;
+                }
+            }
+            session->in_flight.clear();
+
+            if (session->conn != nullptr)
+                session->conn->Destroy();
+        }
+    }
+
+    uint64_t GetSentCount() const noexcept { return m_num_sent; }
+    uint64_t GetCompletedCount() const noexcept { return m_num_completed; }
+    uint64_t GetUnansweredCount() const noexcept { return m_num_unanswered; }
+
+    const Histogram &GetCorrected() const noexcept { return m_corrected; }
+    const Histogram &GetUncorrected() const noexcept { return m_uncorrected; }
+
+private:
+    struct Request {
+        int64_t scheduled;
+        int64_t sent;
+    };
+
+    struct Session {
+        AsyncTcpConnection *conn = nullptr;
+        std::deque<Request> in_flight;
+        int64_t             next_send     = 0;
+        size_t              partial_bytes = 0;
+    };
+
+    /// Next send time of a session.
+    struct Due {
+        int64_t time;
+        size_t  index;
+
+        bool operator>(const Due &other) const noexcept {
+            return time > other.time;
+        }
+    };
+
+    void SendDue() {
+        int64_t now = NowNanos();
+        while (!m_schedule.empty() && m_schedule.top().time <= now) {
+            size_t index = m_schedule.top().index;
+            m_schedule.pop();
+
+            Session &s = *m_sessions[index];
+            if (s.conn == nullptr)
+                continue;
+
+            s.in_flight.push_back(Request{s.next_send, now});
+            s.conn->AsyncSend(m_payload->data(), m_payload->size());
+            s.next_send += m_interval;
+            m_num_sent += 1;
+
+            if (s.next_send < m_stop_at)
+                m_schedule.push(Due{s.next_send, index});
+        }
+    }
+
+#if EVEIO_OS_LINUX
+    void HandlePacer() {
+        uint64_t expirations = 0;
+        if (::read(m_timer_fd, &expirations, sizeof(expirations)) < 0 &&
+            errno == EAGAIN)
+            return;
+
+        SendDue();
+        ArmPacer();
+    }
+
+    /// Wake up at the next send time. steady_clock is CLOCK_MONOTONIC.
+    void ArmPacer() {
+        if (m_schedule.empty())
+            return;
+
+        const int64_t     second = 1000 * 1000 * 1000;
+        int64_t           next   = m_schedule.top().time;
+        struct itimerspec spec {};
+        spec.it_value.tv_sec  = static_cast<time_t>(next / second);
+        spec.it_value.tv_nsec = static_cast<long>(next % second);
+        ::timerfd_settime(m_timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+    }
+#endif
+
+    void HandleResponse(Session &s, AsyncTcpConnBuffer &buffer) {
+        int64_t now = NowNanos();
+        s.partial_bytes += buffer.Size();
+        buffer.Clear();
+
+        while (s.partial_bytes >= m_payload->size() && !s.in_flight.empty()) {
+            s.partial_bytes -= m_payload->size();
+
+            const Request &request = s.in_flight.front();
+            if (request.scheduled >= m_measure_from) {
+                Record(request, now);
+                m_num_completed += 1;
+            }
+            s.in_flight.pop_front();
+        }
+    }
+
+    void Record(const Request &request, int64_t now) noexcept {
+        m_corrected.Record(static_cast<uint64_t>(now - request.scheduled));
+        m_uncorrected.Record(static_cast<uint64_t>(now - request.sent));
+    }
+
+private:
+    EventLoop                            *m_loop;
+    std::shared_ptr<const std::string>    m_payload;
+    std::vector<std::unique_ptr<Session>> m_sessions;
+
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> m_schedule;
+
+    int64_t                   m_interval;
+    int64_t                   m_measure_from;
+    int64_t                   m_stop_at;
+    EventLoop::TimerId        m_timer;
+    int                       m_timer_fd;
+    std::unique_ptr<Listener> m_pacer;
+
+    uint64_t  m_num_sent;
+    uint64_t  m_num_completed;
+    uint64_t  m_num_unanswered;
+    Histogram m_corrected;
+    Histogram m_uncorrected;
+};
+
+/// Run @p fn in every loop and wait for all of them.
+template <typename Fn>
+static void RunInAllLoops(const EventLoopThreadPool::LoopList &loops,
+                          Fn                                   fn) {
+    for (size_t i = 0; i < loops.size(); ++i) {
+        std::promise<void> done;
+        loops[i]->RunInLoop([&fn, &done, i]() {
+            fn(i);
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+static void PrintJsonLatency(const char *name, const Histogram &hist) {
+    printf("\"%s\":{\"p50\":%.1f,\"p90\":%.1f,\"p99\":%.1f,\"p99.9\":%.1f,"
+           "\"p99.99\":%.1f,\"max\":%.1f,\"mean\":%.1f}",
+           name, hist.ValueAt(50) / 1e3, hist.ValueAt(90) / 1e3,
+           hist.ValueAt(99) / 1e3, hist.ValueAt(99.9) / 1e3,
+           hist.ValueAt(99.99) / 1e3, hist.Max() / 1e3, hist.Mean() / 1e3);
+}
+
+static void PrintLatency(const char *name, const Histogram &hist) {
+    printf("%s latency (us):\n", name);
+    printf("  p50     %10.1f\n", hist.ValueAt(50) / 1e3);
+    printf("  p90     %10.1f\n", hist.ValueAt(90) / 1e3);
+    printf("  p99     %10.1f\n", hist.ValueAt(99) / 1e3);
+    printf("  p99.9   %10.1f\n", hist.ValueAt(99.9) / 1e3);
+    printf("  p99.99  %10.1f\n", hist.ValueAt(99.99) / 1e3);
+    printf("  max     %10.1f\n", hist.Max() / 1e3);
+    printf("  mean    %10.1f\n", hist.Mean() / 1e3);
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "r:c:s:t:w:l:a:p:u:S:jh")) != -1) {
+        switch (opt) {
+        case 'r':
+            options.rate = std::strtod(optarg, nullptr);
+            break;
+        case 'c':
+            options.connections = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 's':
+            options.payload_size = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 't':
+            options.seconds = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'w':
+            options.warmup = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'l':
+            options.client_loops = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'a':
+            options.ip = optarg;
+            break;
+        case 'p':
+            options.port =
+                static_cast<uint16_t>(std::strtoul(optarg, nullptr, 10));
+            break;
+        case 'u':
+            options.unix_path = optarg;
+            break;
+        case 'S':
+            options.server_loops = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        default:
+            Usage(argv[0]);
+            return -10;
+        }
+    }
+
+    if (!(options.rate > 0) || options.connections == 0 ||
+        options.payload_size == 0 || options.client_loops == 0 ||
+        options.server_loops == 0 ||
+        (options.port != 0 && !options.unix_path.empty())) {
+        Usage(argv[0]);
+        return -10;
+    }
+
+    // Built-in echo server if no target is given.
+    EventLoop                  server_loop;
+    std::unique_ptr<TcpServer> server;
+    std::thread                server_thread;
+    InetAddr                   addr(options.ip, options.port);
+    UnixAddr                   unix_addr = UnixAddr::Parse(options.unix_path);
+    if (!options.unix_path.empty()) {
+        if (!unix_addr.IsValid()) {
+            fprintf(stderr, "Invalid path %s.\n", options.unix_path.c_str());
+            return -10;
+        }
+
+        if (!unix_addr.IsAbstract())
+            ::unlink(options.unix_path.c_str());
+        server.reset(new TcpServer(
+            server_loop, unix_addr,
+            std::make_shared<EventLoopThreadPool>(options.server_loops)));
+    } else if (options.port == 0) {
+        server.reset(new TcpServer(
+            server_loop, InetAddr::Ipv4Loopback(0),
+            std::make_shared<EventLoopThreadPool>(options.server_loops)));
+    }
+
+    if (server) {
+        server->SetConnectionCallback(
+            [](AsyncTcpConnection *conn) { conn->SetNoDelay(true); });
+        server->SetMessageCallback(
+            [](AsyncTcpConnection *conn, AsyncTcpConnBuffer &buffer) {
+                conn->AsyncSend(buffer.Data<char>(), buffer.Size());
+                buffer.Clear();
+            });
+        server->Start();
+        if (!unix_addr.IsValid() && !server->GetLocalAddr(addr)) {
+            fprintf(stderr, "Failed to get server address.\n");
+            return -1;
+        }
+        server_thread = std::thread([&server_loop]() { server_loop.Loop(); });
+    }
+
+    if (!unix_addr.IsValid() && !addr.IsValid()) {
+        fprintf(stderr, "Invalid target address %s.\n", options.ip.c_str());
+        return -10;
+    }
+
+    auto payload =
+        std::make_shared<const std::string>(options.payload_size, 'x');
+
+    std::vector<std::unique_ptr<Generator>> generators;
+    EventLoopThreadPool                     client_pool(options.client_loops);
+    client_pool.Start();
+    const auto &loops = client_pool.GetAllLoops();
+    for (EventLoop *loop : loops)
+        generators.emplace_back(new Generator(*loop, payload));
+
+    // Connections of one loop get consecutive phases.
+    std::vector<size_t> first_index(loops.size() + 1, 0);
+    for (size_t i = 0; i < loops.size(); ++i) {
+        size_t count = options.connections / loops.size() +
+                       (i < options.connections % loops.size() ? 1 : 0);
+        first_index[i + 1] = first_index[i] + count;
+    }
+
+    for (size_t i = 0; i < loops.size(); ++i) {
+        for (size_t j = first_index[i]; j < first_index[i + 1]; ++j) {
+            TcpConnection conn = unix_addr.IsValid() ? TcpConnection(unix_addr)
+                                                     : TcpConnection(addr);
+            if (!conn.IsValid()) {
+                fprintf(stderr, "Failed to connect to %s.\n",
+                        unix_addr.IsValid() ? unix_addr.GetPath().c_str()
+                                            : addr.GetIpWithPort().c_str());
+                return -1;
+            }
+
+            Generator *generator = generators[i].get();
+            socket_t   sock      = conn.Release();
+            loops[i]->RunInLoop(
+                [generator, sock]() { generator->AddConnection(sock); });
+        }
+    }
+
+    auto interval = static_cast<int64_t>(
+        1e9 * static_cast<double>(options.connections) / options.rate);
+    const int64_t second = 1000 * 1000 * 1000;
+
+    // Give the connections some time to be registered.
+    int64_t start        = NowNanos() + second / 100;
+    int64_t measure_from = start + static_cast<int64_t>(options.warmup) *
+                                       second;
+    int64_t stop_at      = measure_from +
+                      static_cast<int64_t>(options.seconds) * second;
+
+    RunInAllLoops(loops, [&](size_t i) {
+        generators[i]->Start(start, interval, first_index[i],
+                             options.connections, measure_from, stop_at);
+    });
+
+    // Leave one second for the last responses.
+    std::this_thread::sleep_for(
+        std::chrono::nanoseconds(stop_at - NowNanos()) +
+        std::chrono::seconds(1));
+
+    RunInAllLoops(loops, [&](size_t i) { generators[i]->Finish(); });
+
+    Histogram corrected;
+    Histogram uncorrected;
+    uint64_t  num_sent       = 0;
+    uint64_t  num_completed  = 0;
+    uint64_t  num_unanswered = 0;
+    RunInAllLoops(loops, [&](size_t i) {
+        corrected.Merge(generators[i]->GetCorrected());
+        uncorrected.Merge(generators[i]->GetUncorrected());
+        num_sent += generators[i]->GetSentCount();
+        num_completed += generators[i]->GetCompletedCount();
+        num_unanswered += generators[i]->GetUnansweredCount();
+    });
+
+    if (server) {
+        server_loop.Quit();
+        server_thread.join();
+        if (unix_addr.IsValid() && !unix_addr.IsAbstract())
+            ::unlink(options.unix_path.c_str());
+    }
+
+    double achieved = static_cast<double>(num_completed) /
+                      static_cast<double>(options.seconds);
+
+    if (options.json) {
+        printf("{\"benchmark\":\"latency\",\"version\":\"%s\","
+               "\"target_rate\":%.0f,\"achieved_rate\":%.0f,"
+               "\"connections\":%zu,\"payload_size\":%zu,"
+               "\"client_loops\":%zu,\"seconds\":%zu,"
+               "\"completed\":%llu,\"unanswered\":%llu,",
+               EVEIO_VERSION, options.rate, achieved, options.connections,
+               options.payload_size, options.client_loops, options.seconds,
+               static_cast<unsigned long long>(num_completed),
+               static_cast<unsigned long long>(num_unanswered));
+        PrintJsonLatency("latency_us", corrected);
+        printf(",");
+        PrintJsonLatency("service_time_us", uncorrected);
+        printf("}\n");
+        return 0;
+    }
+
+    printf("eveio version:   %s\n", EVEIO_VERSION);
+    printf("target:          %s\n",
+           unix_addr.IsValid() ? unix_addr.GetPath().c_str()
+                               : addr.GetIpWithPort().c_str());
+    printf("target rate:     %.0f req/s\n", options.rate);
+    printf("achieved rate:   %.0f req/s\n", achieved);
+    printf("connections:     %zu\n", options.connections);
+    printf("payload size:    %zu\n", options.payload_size);
+    printf("requests sent:   %llu\n",
+           static_cast<unsigned long long>(num_sent));
+    printf("unanswered:      %llu\n",
+           static_cast<unsigned long long>(num_unanswered));
+    PrintLatency("Corrected", corrected);
+    PrintLatency("Uncorrected", uncorrected);
+    return 0;
+}
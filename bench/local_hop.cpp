@@ -0,0 +1,259 @@
+/// Local hop benchmark: shared memory ring vs AF_UNIX socket.
+///
+/// A child process echoes everything it receives and the parent keeps a
+/// fixed number of messages in flight over one connection. Both sides use the
+/// same templated handlers for AsyncShmConnection and AsyncTcpConnection.
+/// Reports messages/s, the mean round trip and, for the ring, how often a
+/// side had to be woken up, as text or as one JSON line (-j).
+#include "eveio/AsyncShmConnection.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifndef EVEIO_VERSION
+#    define EVEIO_VERSION "unknown"
+#endif
+
+#if !EVEIO_HAS_SHM_RING
+int main() {
+    fprintf(stderr, "Shared memory rings are not supported.\n");
+    return -1;
+}
+#else
+using namespace eveio;
+
+struct Options {
+    size_t message_size = 64;
+    size_t in_flight    = 1;
+    size_t ring_size    = ShmChannel::DEFAULT_RING_SIZE;
+    size_t seconds      = 5;
+    bool   use_shm      = true;
+    bool   json         = false;
+};
+
+static void Usage(const char *name) {
+    printf("Usage: %s [-m shm|unix] [-s size] [-n count] [-r size] "
+           "[-t seconds] [-j]\n"
+           "  -m  Transport. Default shm.\n"
+           "  -s  Message size in bytes. Default 64.\n"
+           "  -n  Messages kept in flight. Default 1.\n"
+           "  -r  Ring size in bytes. Default 1048576.\n"
+           "  -t  Benchmark duration in seconds. Default 5.\n"
+           "  -j  Print result as one JSON line.\n",
+           name);
+}
+
+static uint64_t WakeupCount(AsyncShmConnection *conn) {
+    return conn->GetWakeupCount();
+}
+
+static uint64_t WakeupCount(AsyncTcpConnection *) { return 0; }
+
+static AsyncShmConnection *Wrap(EventLoop     &loop,
+                                TcpConnection &&conn,
+                                bool           is_creator,
+                                size_t         ring_size,
+                                AsyncShmConnection *) {
+    ShmChannel channel = is_creator
+                             ? ShmChannel::Create(std::move(conn), ring_size)
+                             : ShmChannel::Open(std::move(conn));
+    if (!channel.IsValid())
+        return nullptr;
+    return new AsyncShmConnection(loop, std::move(channel));
+}
+
+static AsyncTcpConnection *Wrap(EventLoop     &loop,
+                                TcpConnection &&conn,
+                                bool,
+                                size_t,
+                                AsyncTcpConnection *) {
+    return AsyncTcpConnection::Create(loop, std::move(conn));
+}
+
+/// Child process. Echo until the parent closes the connection.
+template <typename Conn>
+static int RunEcho(TcpConnection &&socket, const Options &options) {
+    EventLoop loop;
+    Conn     *conn = Wrap(loop, std::move(socket), false, options.ring_size,
+                          static_cast<Conn *>(nullptr));
+    if (conn == nullptr)
+        return -1;
+
+    conn->SetMessageCallback([](Conn *c, AsyncTcpConnBuffer &buffer) {
+        c->AsyncSend(buffer.template Data<char>(), buffer.Size());
+        buffer.Clear();
+    });
+    conn->SetCloseCallback([&loop](Conn *) { loop.Quit(); });
+    loop.Loop();
+    return 0;
+}
+
+/// Parent process. Keep messages in flight and count the echoed ones.
+template <typename Conn>
+static int RunClient(TcpConnection &&socket, const Options &options) {
+    EventLoop loop;
+    Conn     *conn = Wrap(loop, std::move(socket), true, options.ring_size,
+                          static_cast<Conn *>(nullptr));
+    if (conn == nullptr) {
+        fprintf(stderr, "Failed to set up the connection.\n");
+        return -1;
+    }
+
+    const std::string message(options.message_size, 'x');
+    uint64_t          num_messages = 0;
+    uint64_t          begin_count  = 0;
+    uint64_t          end_count    = 0;
+    uint64_t          num_wakeups  = 0;
+    bool              is_measuring = false;
+
+    conn->SetMessageCallback([&](Conn *c, AsyncTcpConnBuffer &buffer) {
+        size_t count = buffer.Size() / message.size();
+        buffer.ReadOut(count * message.size());
+        num_messages += count;
+        for (size_t i = 0; i < count; ++i)
+            c->AsyncSend(message.data(), message.size());
+    });
+
+    // Closing the connection lets the child exit as well.
+    conn->SetCloseCallback([&loop](Conn *) { loop.Quit(); });
+
+    for (size_t i = 0; i < options.in_flight; ++i)
+        conn->AsyncSend(message.data(), message.size());
+
+    // Warm up for a moment before measuring.
+    auto start = std::chrono::steady_clock::now();
+    loop.RunAfter(std::chrono::milliseconds(200), [&]() {
+        start        = std::chrono::steady_clock::now();
+        begin_count  = num_messages;
+        num_wakeups  = WakeupCount(conn);
+        is_measuring = true;
+    });
+
+    std::chrono::duration<double> elapsed(0);
+    loop.RunAfter(std::chrono::milliseconds(200 + options.seconds * 1000),
+                  [&]() {
+                      elapsed     = std::chrono::steady_clock::now() - start;
+                      end_count   = num_messages;
+                      num_wakeups = WakeupCount(conn) - num_wakeups;
+                      conn->Destroy();
+                  });
+    loop.Loop();
+
+    if (!is_measuring)
+        return -1;
+
+    double seconds   = elapsed.count();
+    double messages  = static_cast<double>(end_count - begin_count);
+    double in_flight = static_cast<double>(options.in_flight);
+    double rate      = messages / seconds;
+    double rtt_us    = (messages > 0) ? seconds * 1e6 * in_flight / messages
+                                      : 0.0;
+    double wakeups   = (messages > 0)
+                           ? static_cast<double>(num_wakeups) / messages
+                           : 0.0;
+
+    const char *transport = options.use_shm ? "shm" : "unix";
+    if (options.json) {
+        printf("{\"benchmark\":\"local_hop\",\"version\":\"%s\","
+               "\"transport\":\"%s\",\"message_size\":%zu,\"in_flight\":%zu,"
+               "\"seconds\":%.3f,\"messages_per_sec\":%.0f,"
+               "\"mean_rtt_us\":%.3f,\"wakeups_per_message\":%.4f}\n",
+               EVEIO_VERSION, transport, options.message_size,
+               options.in_flight, seconds, rate, rtt_us, wakeups);
+        return 0;
+    }
+
+    printf("eveio %s local hop: %s, %zu byte messages, %zu in flight, "
+           "%.2f seconds\n",
+           EVEIO_VERSION, transport, options.message_size, options.in_flight,
+           seconds);
+    printf("  messages:  %12.0f /s\n", rate);
+    printf("  mean rtt:  %12.3f us\n", rtt_us);
+    if (options.use_shm)
+        printf("  wakeups:   %12.4f per message\n", wakeups);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "m:s:n:r:t:jh")) != -1) {
+        switch (opt) {
+        case 'm':
+            if (std::strcmp(optarg, "shm") == 0) {
+                options.use_shm = true;
+            } else if (std::strcmp(optarg, "unix") == 0) {
+                options.use_shm = false;
+            } else {
+                Usage(argv[0]);
+                return -10;
+            }
+            break;
+        case 's':
+            options.message_size = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'n':
+            options.in_flight = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'r':
+            options.ring_size = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 't':
+            options.seconds = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        default:
+            Usage(argv[0]);
+            return -10;
+        }
+    }
+
+    if (options.message_size == 0 || options.in_flight == 0) {
+        Usage(argv[0]);
+        return -10;
+    }
+
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        fprintf(stderr, "Failed to create socket pair.\n");
+        return -1;
+    }
+
+    // Fork before any loop or thread exists.
+    pid_t pid = ::fork();
+    if (pid < 0) {
+        fprintf(stderr, "Failed to fork.\n");
+        return -1;
+    }
+
+    if (pid == 0) {
+        ::close(sv[0]);
+        int ret = options.use_shm
+                      ? RunEcho<AsyncShmConnection>(TcpConnection(sv[1]),
+                                                    options)
+                      : RunEcho<AsyncTcpConnection>(TcpConnection(sv[1]),
+                                                    options);
+        ::_exit(ret == 0 ? 0 : 1);
+    }
+
+    ::close(sv[1]);
+    int ret = options.use_shm
+                  ? RunClient<AsyncShmConnection>(TcpConnection(sv[0]),
+                                                  options)
+                  : RunClient<AsyncTcpConnection>(TcpConnection(sv[0]),
+                                                  options);
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    return ret;
+}
+#endif // EVEIO_HAS_SHM_RING
@@ -0,0 +1,395 @@
+/// Microbenchmarks of eveio hot paths.
+///
+/// Every case is calibrated to run for at least the minimum time, then
+/// repeated several times. The median and the best time per operation are
+/// reported, so results of different builds could be compared directly. Run
+/// with a name filter to measure only some of the cases.
+#include "eveio/AsyncTcpConnection.h"
+#include "eveio/EventLoopThread.h"
+#include "eveio/Listener.h"
+#include "eveio/WakeupHandle.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef EVEIO_VERSION
+#    define EVEIO_VERSION "unknown"
+#endif
+
+using namespace eveio;
+
+struct Options {
+    std::string filter;
+    size_t      repetitions = 5;
+    size_t      min_time_ms = 100;
+    bool        json        = false;
+};
+
+/// Keep the compiler from optimizing @p value away.
+template <typename T>
+static inline void DoNotOptimize(const T &value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+static int64_t NowNanos() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// Runs benchmark cases. A case is a callable taking the number of
+/// iterations and returning the nanoseconds spent on them, so that setup
+/// could be excluded.
+class Runner {
+public:
+    explicit Runner(const Options &options)
+        : m_options(options),
+          m_min_time(static_cast<int64_t>(options.min_time_ms) * 1000 * 1000) {}
+
+    template <typename Fn>
+    void Run(const std::string &name, Fn fn) {
+        if (!m_options.filter.empty() &&
+            name.find(m_options.filter) == std::string::npos)
+            return;
+
+        // Grow iterations until one run is long enough.
+        size_t  iterations = 1;
+        int64_t elapsed    = fn(iterations);
+        while (elapsed < m_min_time) {
+            double scale = 10.0;
+            if (elapsed > 0) {
+                scale = 1.2 * static_cast<double>(m_min_time) /
+                        static_cast<double>(elapsed);
+            }
+
+            scale      = std::min(std::max(scale, 2.0), 100.0);
+            iterations = static_cast<size_t>(static_cast<double>(iterations) *
+                                             scale);
+            elapsed    = fn(iterations);
+        }
+
+        std::vector<double> samples;
+        for (size_t i = 0; i < m_options.repetitions; ++i) {
+            samples.push_back(static_cast<double>(fn(iterations)) /
+                              static_cast<double>(iterations));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        double median = samples[samples.size() / 2];
+        double best   = samples.front();
+        if (m_options.json) {
+            printf("{\"benchmark\":\"micro\",\"version\":\"%s\","
+                   "\"name\":\"%s\",\"iterations\":%zu,"
+                   "\"ns_per_op\":%.2f,\"best_ns_per_op\":%.2f,"
+                   "\"ops_per_sec\":%.0f}\n",
+                   EVEIO_VERSION, name.c_str(), iterations, median, best,
+                   1e9 / median);
+        } else {
+            printf("%-44s %12.2f ns/op %12.2f best %14.0f op/s\n",
+                   name.c_str(), median, best, 1e9 / median);
+        }
+        fflush(stdout);
+    }
+
+private:
+    Options m_options;
+    int64_t m_min_time;
+};
+
+static void BenchRunInLoop(Runner &runner) {
+    EventLoopThread thread;
+    EventLoop      *loop = thread.StartLoop();
+
+    runner.Run("RunInLoop/round_trip", [loop](size_t iterations) {
+        std::atomic_bool done{false};
+        int64_t          start = NowNanos();
+        for (size_t i = 0; i < iterations; ++i) {
+            done.store(false, std::memory_order_relaxed);
+            loop->RunInLoop(
+                [&done]() { done.store(true, std::memory_order_release); });
+            while (!done.load(std::memory_order_acquire)) {
+            }
+        }
+        return NowNanos() - start;
+    });
+
+    for (size_t producers : {1, 2, 4, 8}) {
+        std::string name = "RunInLoop/throughput/producers:" +
+                           std::to_string(producers);
+        runner.Run(name, [loop, producers](size_t iterations) {
+            // Counter is only touched in loop thread.
+            size_t           executed     = 0;
+            size_t           per_producer = (iterations + producers - 1) /
+                                  producers;
+            size_t           total = per_producer * producers;
+            std::atomic_bool done{false};
+
+            int64_t                  start = NowNanos();
+            std::vector<std::thread> threads;
+            for (size_t i = 0; i < producers; ++i) {
+                threads.emplace_back([&]() {
+                    for (size_t j = 0; j < per_producer; ++j) {
+                        loop->RunInLoop([&executed, &done, total]() {
+                            if (++executed == total)
+                                done.store(true, std::memory_order_release);
+                        });
+                    }
+                });
+            }
+
+            for (auto &t : threads)
+                t.join();
+            while (!done.load(std::memory_order_acquire)) {
+            }
+            return (NowNanos() - start) *
+                   static_cast<int64_t>(iterations) /
+                   static_cast<int64_t>(total);
+        });
+    }
+}
+
+static void BenchWakeupHandle(Runner &runner) {
+    WakeupHandle handle;
+
+    runner.Run("WakeupHandle/Trigger", [&handle](size_t iterations) {
+        int64_t start = NowNanos();
+        for (size_t i = 0; i < iterations; ++i)
+            handle.Trigger();
+        int64_t elapsed = NowNanos() - start;
+        handle.Respond();
+        return elapsed;
+    });
+
+    runner.Run("WakeupHandle/Trigger+Respond", [&handle](size_t iterations) {
+        int64_t start = NowNanos();
+        for (size_t i = 0; i < iterations; ++i) {
+            handle.Trigger();
+            handle.Respond();
+        }
+        return NowNanos() - start;
+    });
+}
+
+static void BenchConnBuffer(Runner &runner) {
+    for (size_t size : {16, 256, 4096, 65536}) {
+        std::string name = "AsyncTcpConnBuffer/Append+ReadOut/size:" +
+                           std::to_string(size);
+        runner.Run(name, [size](size_t iterations) {
+            BufferPool         pool;
+            AsyncTcpConnBuffer buffer(&pool, BufferPool::CATEGORY_READ);
+            std::vector<char>  data(size, 'x');
+
+            // Keep a few messages buffered, like a partially drained
+            // connection does.
+            for (size_t i = 0; i < 4; ++i)
+                buffer.Append(data.data(), data.size());
+
+            int64_t start = NowNanos();
+            for (size_t i = 0; i < iterations; ++i) {
+                buffer.Append(data.data(), data.size());
+                DoNotOptimize(buffer.Data<char>()[0]);
+                buffer.ReadOut(size);
+            }
+            return NowNanos() - start;
+        });
+    }
+
+    for (size_t size : {16, 4096}) {
+        std::string name = "AsyncTcpConnBuffer/Append+Clear/size:" +
+                           std::to_string(size);
+        runner.Run(name, [size](size_t iterations) {
+            BufferPool         pool;
+            AsyncTcpConnBuffer buffer(&pool, BufferPool::CATEGORY_READ);
+            std::vector<char>  data(size, 'x');
+
+            int64_t start = NowNanos();
+            for (size_t i = 0; i < iterations; ++i) {
+                buffer.Append(data.data(), data.size());
+                DoNotOptimize(buffer.Data<char>()[0]);
+                buffer.Clear();
+            }
+            return NowNanos() - start;
+        });
+    }
+}
+
+/// Level-triggered eventfd that is always readable.
+class ReadyFd {
+public:
+    ReadyFd() : m_fd(::eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC)) {}
+    ~ReadyFd() { ::close(m_fd); }
+
+    ReadyFd(const ReadyFd &) = delete;
+    ReadyFd &operator=(const ReadyFd &) = delete;
+
+    int Get() const noexcept { return m_fd; }
+
+private:
+    int m_fd;
+};
+
+static void BenchUpdateListener(Runner &runner) {
+    runner.Run("EPollPoller/UpdateListener/mod", [](size_t iterations) {
+        EventLoop loop;
+        ReadyFd   fd;
+        Listener  listener(loop, fd.Get());
+        listener.EnableReading();
+
+        int64_t start = NowNanos();
+        for (size_t i = 0; i < iterations; i += 2) {
+            listener.EnableWriting();
+            listener.DisableWriting();
+        }
+        return NowNanos() - start;
+    });
+
+    runner.Run("EPollPoller/UpdateListener/add+del", [](size_t iterations) {
+        EventLoop loop;
+        ReadyFd   fd;
+        Listener  listener(loop, fd.Get());
+
+        int64_t start = NowNanos();
+        for (size_t i = 0; i < iterations; i += 2) {
+            listener.EnableReading();
+            listener.DisableReading();
+        }
+        return NowNanos() - start;
+    });
+}
+
+struct DispatchCounter {
+    EventLoop *loop;
+    size_t     count;
+    size_t     target;
+};
+
+static void BenchDispatch(Runner &runner) {
+    for (size_t num_listeners : {1, 64, 1024, 4096}) {
+        std::string name = "EPollPoller/HandleEvents/ready:" +
+                           std::to_string(num_listeners);
+        runner.Run(name, [num_listeners](size_t iterations) {
+            EventLoop       loop;
+            DispatchCounter counter{&loop, 0, iterations};
+
+            std::vector<std::unique_ptr<ReadyFd>>  fds;
+            std::vector<std::unique_ptr<Listener>> listeners;
+            for (size_t i = 0; i < num_listeners; ++i) {
+                fds.emplace_back(new ReadyFd);
+                listeners.emplace_back(new Listener(loop, fds.back()->Get()));
+
+                Listener *listener = listeners.back().get();
+                listener->TieObject(&counter);
+                listener->SetReadCallback([](Listener *l) {
+                    auto c = static_cast<DispatchCounter *>(l->GetTiedObject());
+                    if (++c->count == c->target)
+                        c->loop->Quit();
+                });
+                listener->EnableReading();
+            }
+
+            int64_t start = NowNanos();
+            loop.Loop();
+            return (NowNanos() - start) * static_cast<int64_t>(iterations) /
+                   static_cast<int64_t>(counter.count);
+        });
+    }
+}
+
+static void BenchInetAddr(Runner &runner) {
+    runner.Run("InetAddr/parse/ipv4", [](size_t iterations) {
+        int64_t start = NowNanos();
+        for (size_t i = 0; i < iterations; ++i) {
+            InetAddr addr("192.168.100.200", 8080);
+            DoNotOptimize(addr);
+        }
+        return NowNanos() - start;
+    });
+
+    runner.Run("InetAddr/parse/ipv6", [](size_t iterations) {
+        int64_t start = NowNanos();
+        for (size_t i = 0; i < iterations; ++i) {
+            InetAddr addr("fe80::1ff:fe23:4567:890a", 8080);
+            DoNotOptimize(addr);
+        }
+        return NowNanos() - start;
+    });
+
+    runner.Run("InetAddr/format/ipv4", [](size_t iterations) {
+        InetAddr addr("192.168.100.200", 8080);
+        int64_t  start = NowNanos();
+        for (size_t i = 0; i < iterations; ++i) {
+            std::string text = addr.GetIpWithPort();
+            DoNotOptimize(text.data());
+        }
+        return NowNanos() - start;
+    });
+
+    runner.Run("InetAddr/format/ipv6", [](size_t iterations) {
+        InetAddr addr("fe80::1ff:fe23:4567:890a", 8080);
+        int64_t  start = NowNanos();
+        for (size_t i = 0; i < iterations; ++i) {
+            std::string text = addr.GetIpWithPort();
+            DoNotOptimize(text.data());
+        }
+        return NowNanos() - start;
+    });
+}
+
+static void Usage(const char *name) {
+    printf("Usage: %s [-f filter] [-r repetitions] [-m milliseconds] [-j]\n"
+           "  -f  Only run cases whose name contains filter.\n"
+           "  -r  Repetitions of each case. Default 5.\n"
+           "  -m  Minimum time of one repetition. Default 100.\n"
+           "  -j  Print one JSON line per case.\n",
+           name);
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "f:r:m:jh")) != -1) {
+        switch (opt) {
+        case 'f':
+            options.filter = optarg;
+            break;
+        case 'r':
+            options.repetitions = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'm':
+            options.min_time_ms = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        default:
+            Usage(argv[0]);
+            return -10;
+        }
+    }
+
+    if (options.repetitions == 0) {
+        Usage(argv[0]);
+        return -10;
+    }
+
+    Runner runner(options);
+    BenchRunInLoop(runner);
+    BenchWakeupHandle(runner);
+    BenchConnBuffer(runner);
+    BenchUpdateListener(runner);
+    BenchDispatch(runner);
+    BenchInetAddr(runner);
+    return 0;
+}
@@ -0,0 +1,212 @@
+/// Ping-pong throughput benchmark.
+///
+/// Every client connection sends one message to an echo server and echoes
+/// back whatever it receives, so each connection keeps one message in flight.
+/// Server and clients both run on eveio in this process. Reports MiB/s and
+/// messages/s seen by the clients, as text or as one JSON line (-j) for
+/// tracking regressions across versions.
+#include "eveio/TcpServer.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef EVEIO_VERSION
+#    define EVEIO_VERSION "unknown"
+#endif
+
+using namespace eveio;
+
+struct Options {
+    size_t message_size = 4096;
+    size_t connections  = 100;
+    size_t server_loops = 2;
+    size_t client_loops = 2;
+    size_t seconds      = 10;
+    bool   json         = false;
+};
+
+/// Counters of one client loop. Only touched in that loop thread.
+struct ClientStats {
+    uint64_t bytes_read = 0;
+};
+
+static void Usage(const char *name) {
+    printf("Usage: %s [-s size] [-c connections] [-S loops] [-C loops] "
+           "[-t seconds] [-j]\n"
+           "  -s  Message size in bytes. Default 4096.\n"
+           "  -c  Number of client connections. Default 100.\n"
+           "  -S  Number of server worker loops. Default 2.\n"
+           "  -C  Number of client loops. Default 2.\n"
+           "  -t  Benchmark duration in seconds. Default 10.\n"
+           "  -j  Print result as one JSON line.\n",
+           name);
+}
+
+/// Sum up bytes read by all client loops. Counters are read in their own
+/// loop threads.
+static uint64_t
+CollectBytes(const EventLoopThreadPool::LoopList             &loops,
+             const std::vector<std::unique_ptr<ClientStats>> &stats) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < loops.size(); ++i) {
+        std::promise<uint64_t> bytes;
+        ClientStats           *loop_stats = stats[i].get();
+        loops[i]->RunInLoop([loop_stats, &bytes]() {
+            bytes.set_value(loop_stats->bytes_read);
+        });
+        total += bytes.get_future().get();
+    }
+    return total;
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "s:c:S:C:t:jh")) != -1) {
+        switch (opt) {
+        case 's':
+            options.message_size = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'c':
+            options.connections = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'S':
+            options.server_loops = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'C':
+            options.client_loops = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 't':
+            options.seconds = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        default:
+            Usage(argv[0]);
+            return -10;
+        }
+    }
+
+    if (options.message_size == 0 || options.connections == 0 ||
+        options.server_loops == 0 || options.client_loops == 0) {
+        Usage(argv[0]);
+        return -10;
+    }
+
+    EventLoop loop;
+    auto server_pool = std::make_shared<EventLoopThreadPool>(
+        options.server_loops);
+    TcpServer server(loop, InetAddr::Ipv4Loopback(0), server_pool);
+
+    server.SetConnectionCallback(
+        [](AsyncTcpConnection *conn) { conn->SetNoDelay(true); });
+    server.SetMessageCallback(
+        [](AsyncTcpConnection *conn, AsyncTcpConnBuffer &buffer) {
+            conn->AsyncSend(buffer.Data<char>(), buffer.Size());
+            buffer.Clear();
+        });
+    server.Start();
+
+    InetAddr addr;
+    if (!server.GetLocalAddr(addr)) {
+        fprintf(stderr, "Failed to get server address.\n");
+        return -1;
+    }
+
+    EventLoopThreadPool client_pool(options.client_loops);
+    client_pool.Start();
+    const auto &client_loops = client_pool.GetAllLoops();
+
+    // One callback set and one counter per client loop.
+    std::vector<std::unique_ptr<ClientStats>>                   stats;
+    std::vector<std::shared_ptr<const TcpConnectionCallbacks>> callbacks;
+    for (size_t i = 0; i < client_loops.size(); ++i) {
+        stats.emplace_back(new ClientStats);
+
+        ClientStats *loop_stats = stats.back().get();
+        auto         cb         = std::make_shared<TcpConnectionCallbacks>();
+
+        cb->msg_callback = [loop_stats](AsyncTcpConnection *conn,
+                                        AsyncTcpConnBuffer &buffer) {
+            loop_stats->bytes_read += buffer.Size();
+            conn->AsyncSend(buffer.Data<char>(), buffer.Size());
+            buffer.Clear();
+        };
+        callbacks.push_back(std::move(cb));
+    }
+
+    auto message = std::make_shared<std::string>(options.message_size, 'x');
+    for (size_t i = 0; i < options.connections; ++i) {
+        TcpConnection conn(addr);
+        if (!conn.IsValid() || !conn.SetNoDelay(true)) {
+            fprintf(stderr, "Failed to connect to server.\n");
+            return -1;
+        }
+
+        EventLoop *client_loop = client_loops[i % client_loops.size()];
+        auto       cb          = callbacks[i % client_loops.size()];
+        socket_t   sock        = conn.Release();
+        client_loop->RunInLoop([client_loop, cb, sock, message]() {
+            AsyncTcpConnection *client = AsyncTcpConnection::Create(
+                *client_loop, TcpConnection(sock));
+            client->SetCallbacks(cb);
+            client->AsyncSend(message->data(), message->size());
+        });
+    }
+
+    uint64_t start_bytes = 0;
+    uint64_t end_bytes   = 0;
+    std::chrono::duration<double> elapsed(0);
+
+    std::thread timer([&]() {
+        auto start  = std::chrono::steady_clock::now();
+        start_bytes = CollectBytes(client_loops, stats);
+
+        std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+
+        end_bytes = CollectBytes(client_loops, stats);
+        elapsed   = std::chrono::steady_clock::now() - start;
+        loop.Quit();
+    });
+
+    loop.Loop();
+    timer.join();
+
+    double bytes    = static_cast<double>(end_bytes - start_bytes);
+    double seconds  = elapsed.count();
+    double mib      = bytes / (1024.0 * 1024.0);
+    double messages = bytes / static_cast<double>(options.message_size);
+
+    if (options.json) {
+        printf("{\"benchmark\":\"pingpong\",\"version\":\"%s\","
+               "\"message_size\":%zu,\"connections\":%zu,"
+               "\"server_loops\":%zu,\"client_loops\":%zu,"
+               "\"seconds\":%.3f,\"bytes\":%.0f,\"messages\":%.0f,"
+               "\"mib_per_sec\":%.2f,\"messages_per_sec\":%.0f}\n",
+               EVEIO_VERSION, options.message_size, options.connections,
+               options.server_loops, options.client_loops, seconds, bytes,
+               messages, mib / seconds, messages / seconds);
+        return 0;
+    }
+
+    printf("eveio version:   %s\n", EVEIO_VERSION);
+    printf("message size:    %zu\n", options.message_size);
+    printf("connections:     %zu\n", options.connections);
+    printf("server loops:    %zu\n", options.server_loops);
+    printf("client loops:    %zu\n", options.client_loops);
+    printf("duration:        %.3f s\n", seconds);
+    printf("throughput:      %.2f MiB/s\n", mib / seconds);
+    printf("messages/sec:    %.0f\n", messages / seconds);
+    return 0;
+}
@@ -0,0 +1,461 @@
+/// Connection scale benchmark.
+///
+/// Ramps up to a large number of idle loopback connections in steps and
+/// profiles the server at each step. Clients run in a forked process so that
+/// their file descriptors and memory do not count against the server. Each
+/// client thread binds to its own source addresses in 127.0.1.0/24, so the
+/// number of connections is not limited by one ephemeral port range.
+///
+/// Reported per step:
+/// - time to establish the step and the accept rate seen by the server,
+/// - server RSS and RSS growth per connection,
+/// - kernel TCP memory from /proc/net/sockstat (system wide),
+/// - the worst loop wake up round trip, which grows with epoll_wait cost,
+/// - connection objects and buffer bytes held by the worker loops.
+///
+/// Finally all clients reset their connections and the teardown rate is
+/// reported. Raise the hard RLIMIT_NOFILE and fs.nr_open for more than about
+/// one million connections.
+#include "eveio/TcpServer.h"
+
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef EVEIO_VERSION
+#    define EVEIO_VERSION "unknown"
+#endif
+
+using namespace eveio;
+
+struct Options {
+    size_t connections    = 100000;
+    size_t step           = 10000;
+    size_t server_loops   = 2;
+    size_t client_threads = 4;
+    size_t source_ips     = 0;
+    bool   json           = false;
+};
+
+/// Sent to the client process to close all connections and exit.
+static constexpr const uint64_t CLIENT_QUIT = UINT64_MAX;
+
+static void Usage(const char *name) {
+    printf("Usage: %s [-n connections] [-k step] [-S loops] [-C threads] "
+           "[-i ips] [-j]\n"
+           "  -n  Total number of connections. Default 100000.\n"
+           "  -k  Connections added per step. Default 10000.\n"
+           "  -S  Number of server worker loops. Default 2.\n"
+           "  -C  Number of client threads. Default 4.\n"
+           "  -i  Number of client source IPs. Default 1 per 5000 "
+           "connections.\n"
+           "  -j  Print one JSON line per step.\n",
+           name);
+}
+
+static int64_t NowNanos() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+/// Raise the soft file descriptor limit as far as allowed. Returns the limit.
+static uint64_t RaiseFileLimit() noexcept {
+    struct rlimit limit;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0)
+        return 0;
+
+    limit.rlim_cur = limit.rlim_max;
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    return static_cast<uint64_t>(limit.rlim_cur);
+}
+
+static bool ReadFull(int fd, uint64_t &value) noexcept {
+    return ::read(fd, &value, sizeof(value)) ==
+           static_cast<ssize_t>(sizeof(value));
+}
+
+static bool WriteFull(int fd, uint64_t value) noexcept {
+    return ::write(fd, &value, sizeof(value)) ==
+           static_cast<ssize_t>(sizeof(value));
+}
+
+static size_t GetRssBytes() {
+    std::ifstream statm("/proc/self/statm");
+    size_t        size     = 0;
+    size_t        resident = 0;
+    statm >> size >> resident;
+    return resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+/// Kernel memory used by all TCP sockets in the system.
+static size_t GetTcpMemBytes() {
+    std::ifstream sockstat("/proc/net/sockstat");
+    std::string   token;
+    while (sockstat >> token) {
+        if (token == "TCP:") {
+            while (sockstat >> token) {
+                if (token == "mem") {
+                    size_t pages = 0;
+                    sockstat >> pages;
+                    return pages *
+                           static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/// Client process. Blocks for targets from @p cmd_fd, opens connections until
+/// the target is reached and replies the number of open connections.
+static int RunClients(const Options &options,
+                      const InetAddr &server,
+                      int             cmd_fd,
+                      int             reply_fd) {
+    size_t num_threads = options.client_threads;
+    std::vector<std::vector<int>> fds(num_threads);
+
+    uint64_t target = 0;
+    while (ReadFull(cmd_fd, target) && target != CLIENT_QUIT) {
+        size_t opened = 0;
+        for (const auto &list : fds)
+            opened += list.size();
+
+        size_t missing = (target > opened) ? target - opened : 0;
+
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_threads; ++t) {
+            size_t count = missing / num_threads +
+                           (t < missing % num_threads ? 1 : 0);
+            threads.emplace_back([&options, &server, &fds, t, count]() {
+                std::vector<int> &list = fds[t];
+                for (size_t i = 0; i < count; ++i) {
+                    // Spread connections of this thread over its addresses.
+                    size_t ip_index = (list.size() * options.client_threads +
+                                       t) %
+                                      options.source_ips;
+
+                    struct sockaddr_in local;
+                    std::memset(&local, 0, sizeof(local));
+                    local.sin_family      = AF_INET;
+                    local.sin_addr.s_addr = htonl(
+                        static_cast<uint32_t>(0x7F000100 + 1 + ip_index));
+
+                    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                    if (fd < 0)
+                        return;
+
+                    int on = 1;
+#ifdef IP_BIND_ADDRESS_NO_PORT
+                    ::setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &on,
+                                 sizeof(on));
+#endif
+                    if (::bind(fd, reinterpret_cast<sockaddr *>(&local),
+                               sizeof(local)) != 0 ||
+                        ::connect(fd, server.AsSockaddr(),
+                                  static_cast<socklen_t>(
+                                      server.GetAddrSize())) != 0) {
+                        ::close(fd);
+                        return;
+                    }
+                    list.push_back(fd);
+                }
+            });
+        }
+
+        opened = 0;
+        for (size_t t = 0; t < num_threads; ++t) {
+            threads[t].join();
+            opened += fds[t].size();
+        }
+
+        if (!WriteFull(reply_fd, opened))
+            break;
+    }
+
+    // Reset instead of close to keep ports out of TIME_WAIT.
+    struct linger reset = {1, 0};
+    for (const auto &list : fds) {
+        for (int fd : list) {
+            ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof(reset));
+            ::close(fd);
+        }
+    }
+
+    WriteFull(reply_fd, 0);
+    return 0;
+}
+
+struct LoopSample {
+    int64_t         wakeup_nanos = 0;
+    size_t          connections  = 0;
+    ObjectPoolStats object_stats;
+    BufferPoolStats buffer_stats;
+};
+
+/// Sample statistics of @p loop in its own thread. The round trip of a
+/// no-op task measures how long the loop takes to wake up and poll.
+static LoopSample SampleLoop(EventLoop *loop) {
+    const int ROUNDS = 32;
+
+    LoopSample sample;
+    for (int i = 0; i < ROUNDS; ++i) {
+        std::promise<void> done;
+        int64_t            start = NowNanos();
+        loop->RunInLoop([&done]() { done.set_value(); });
+        done.get_future().wait();
+        sample.wakeup_nanos += NowNanos() - start;
+    }
+    sample.wakeup_nanos /= ROUNDS;
+
+    std::promise<void> done;
+    loop->RunInLoop([loop, &sample, &done]() {
+        sample.connections  = loop->GetConnectionTable().Size();
+        sample.object_stats = loop->GetConnectionPool().GetStats();
+        sample.buffer_stats = loop->GetBufferPool().GetStats();
+        done.set_value();
+    });
+    done.get_future().wait();
+    return sample;
+}
+
+/// Wait until @p counter reaches @p target or no progress is made for 10s.
+static bool WaitFor(const std::atomic<size_t> &counter, size_t target) {
+    size_t  last     = counter.load(std::memory_order_relaxed);
+    int64_t deadline = NowNanos() + 10LL * 1000 * 1000 * 1000;
+    while (true) {
+        size_t current = counter.load(std::memory_order_relaxed);
+        if (current == target)
+            return true;
+
+        if (current != last) {
+            last     = current;
+            deadline = NowNanos() + 10LL * 1000 * 1000 * 1000;
+        } else if (NowNanos() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "n:k:S:C:i:jh")) != -1) {
+        switch (opt) {
+        case 'n':
+            options.connections = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'k':
+            options.step = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'S':
+            options.server_loops = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'C':
+            options.client_threads = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'i':
+            options.source_ips = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        default:
+            Usage(argv[0]);
+            return -10;
+        }
+    }
+
+    // The kernel searches ephemeral ports slowly once a source address has
+    // used a good part of its range.
+    if (options.source_ips == 0)
+        options.source_ips = options.connections / 5000 + 1;
+
+    if (options.connections == 0 || options.step == 0 ||
+        options.server_loops == 0 || options.client_threads == 0 ||
+        options.source_ips > 254) {
+        Usage(argv[0]);
+        return -10;
+    }
+
+    uint64_t file_limit = RaiseFileLimit();
+    if (file_limit < options.connections + 64) {
+        fprintf(stderr,
+                "Warning: file descriptor limit %llu is too low for %zu "
+                "connections.\n",
+                static_cast<unsigned long long>(file_limit),
+                options.connections);
+    }
+
+    // Bind the listening socket before forking so that the client knows the
+    // port. No thread may be started before fork.
+    EventLoop loop;
+    auto      pool = std::make_shared<EventLoopThreadPool>(
+        options.server_loops);
+    TcpServer server(loop, InetAddr::Ipv4Loopback(0), pool);
+
+    InetAddr addr;
+    if (!server.GetLocalAddr(addr)) {
+        fprintf(stderr, "Failed to get server address.\n");
+        return -1;
+    }
+
+    int cmd_pipe[2];
+    int reply_pipe[2];
+    if (::pipe(cmd_pipe) != 0 || ::pipe(reply_pipe) != 0) {
+        fprintf(stderr, "Failed to create pipes: %s.\n", std::strerror(errno));
+        return -1;
+    }
+
+    pid_t child = ::fork();
+    if (child < 0) {
+        fprintf(stderr, "Failed to fork: %s.\n", std::strerror(errno));
+        return -1;
+    }
+
+    if (child == 0) {
+        ::close(cmd_pipe[1]);
+        ::close(reply_pipe[0]);
+        int ret = RunClients(options, addr, cmd_pipe[0], reply_pipe[1]);
+        ::_exit(ret);
+    }
+
+    ::close(cmd_pipe[0]);
+    ::close(reply_pipe[1]);
+
+    std::atomic<size_t> num_open{0};
+    server.SetConnectionCallback([&num_open](AsyncTcpConnection *) {
+        num_open.fetch_add(1, std::memory_order_relaxed);
+    });
+    server.SetCloseCallback([&num_open](AsyncTcpConnection *) {
+        num_open.fetch_sub(1, std::memory_order_relaxed);
+    });
+    server.Start();
+
+    std::thread loop_thread([&loop]() { loop.Loop(); });
+
+    size_t base_rss = GetRssBytes();
+    if (!options.json) {
+        printf("eveio version: %s\n", EVEIO_VERSION);
+        printf("sizeof(AsyncTcpConnection): %zu, sizeof(Listener): %zu\n",
+               sizeof(AsyncTcpConnection), sizeof(Listener));
+        printf("%10s %9s %10s %9s %9s %10s %10s %10s %10s\n", "conns",
+               "ramp(ms)", "accept/s", "rss(MiB)", "B/conn", "tcpmem(KiB)",
+               "wakeup(us)", "objects", "buf(KiB)");
+    }
+
+    size_t target = 0;
+    while (target < options.connections) {
+        target = std::min(target + options.step, options.connections);
+
+        size_t   before = num_open.load(std::memory_order_relaxed);
+        int64_t  start  = NowNanos();
+        uint64_t opened = 0;
+        if (!WriteFull(cmd_pipe[1], target) || !ReadFull(reply_pipe[0], opened))
+            break;
+
+        bool    reached = WaitFor(num_open, opened);
+        int64_t elapsed = NowNanos() - start;
+        size_t  conns   = num_open.load(std::memory_order_relaxed);
+
+        LoopSample total;
+        for (EventLoop *worker : pool->GetAllLoops()) {
+            LoopSample sample  = SampleLoop(worker);
+            total.wakeup_nanos = std::max(total.wakeup_nanos,
+                                          sample.wakeup_nanos);
+            total.connections += sample.connections;
+            total.object_stats.cached_objects +=
+                sample.object_stats.cached_objects;
+            total.buffer_stats.read_buffer_bytes +=
+                sample.buffer_stats.read_buffer_bytes;
+            total.buffer_stats.write_buffer_bytes +=
+                sample.buffer_stats.write_buffer_bytes;
+            total.buffer_stats.cached_bytes += sample.buffer_stats.cached_bytes;
+        }
+
+        size_t rss      = GetRssBytes();
+        double rss_diff = static_cast<double>(rss) -
+                          static_cast<double>(base_rss);
+        double per_conn = (conns == 0) ? 0 : rss_diff / conns;
+
+        double accept_rate  = static_cast<double>(conns - before) * 1e9 /
+                             static_cast<double>(elapsed);
+        size_t buffer_bytes = total.buffer_stats.read_buffer_bytes +
+                              total.buffer_stats.write_buffer_bytes +
+                              total.buffer_stats.cached_bytes;
+
+        if (options.json) {
+            printf("{\"benchmark\":\"scale\",\"version\":\"%s\","
+                   "\"connections\":%zu,\"ramp_ms\":%.1f,"
+                   "\"accept_per_sec\":%.0f,\"rss_bytes\":%zu,"
+                   "\"rss_per_connection\":%.0f,\"tcp_mem_bytes\":%zu,"
+                   "\"loop_wakeup_us\":%.1f,\"connection_objects\":%zu,"
+                   "\"cached_objects\":%zu,\"buffer_bytes\":%zu}\n",
+                   EVEIO_VERSION, conns, elapsed / 1e6, accept_rate, rss,
+                   per_conn, GetTcpMemBytes(), total.wakeup_nanos / 1e3,
+                   total.connections, total.object_stats.cached_objects,
+                   buffer_bytes);
+        } else {
+            printf("%10zu %9.1f %10.0f %9.1f %9.0f %10zu %10.1f %10zu "
+                   "%10zu\n",
+                   conns, elapsed / 1e6, accept_rate,
+                   static_cast<double>(rss) / (1024.0 * 1024.0), per_conn,
+                   GetTcpMemBytes() / 1024, total.wakeup_nanos / 1e3,
+                   total.connections, buffer_bytes / 1024);
+        }
+        fflush(stdout);
+
+        if (!reached || opened < target) {
+            fprintf(stderr,
+                    "Stopped at %zu connections. Check file descriptor "
+                    "limits and source IPs.\n",
+                    conns);
+            break;
+        }
+    }
+
+    // Teardown.
+    size_t  conns = num_open.load(std::memory_order_relaxed);
+    int64_t start = NowNanos();
+    WriteFull(cmd_pipe[1], CLIENT_QUIT);
+    WaitFor(num_open, 0);
+    int64_t elapsed = NowNanos() - start;
+
+    uint64_t ignored = 0;
+    ReadFull(reply_pipe[0], ignored);
+    ::waitpid(child, nullptr, 0);
+
+    double teardown_rate = (elapsed == 0) ? 0
+                                          : static_cast<double>(conns) * 1e9 /
+                                                static_cast<double>(elapsed);
+    if (options.json) {
+        printf("{\"benchmark\":\"scale\",\"version\":\"%s\","
+               "\"teardown_connections\":%zu,\"teardown_ms\":%.1f,"
+               "\"teardown_per_sec\":%.0f}\n",
+               EVEIO_VERSION, conns, elapsed / 1e6, teardown_rate);
+    } else {
+        printf("teardown: %zu connections in %.1f ms, %.0f/s\n", conns,
+               elapsed / 1e6, teardown_rate);
+    }
+
+    loop.Quit();
+    loop_thread.join();
+    return 0;
+}
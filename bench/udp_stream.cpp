@@ -0,0 +1,260 @@
+/// One-way UDP streaming benchmark.
+///
+/// A sender loop keeps its send queue full of datagrams to a receiver loop
+/// over loopback. With -g the sender hands whole buffers to the kernel with
+/// UDP_SEGMENT, and with -r the receiver lets the kernel coalesce datagrams
+/// with UDP_GRO. Reports datagrams per second, MiB/s, datagrams per system
+/// call on both sides and the loss rate, as text or as one JSON line (-j).
+#include "eveio/AsyncUdpEndpoint.h"
+#include "eveio/EventLoopThread.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+
+#ifndef EVEIO_VERSION
+#    define EVEIO_VERSION "unknown"
+#endif
+
+using namespace eveio;
+
+struct Options {
+    size_t datagram_size = 1200;
+    size_t buffer_size   = 64 * 1024;
+    size_t queue_size    = 1024 * 1024;
+    size_t seconds       = 5;
+    bool   gso           = false;
+    bool   gro           = false;
+    bool   json          = false;
+};
+
+struct Sample {
+    UdpEndpointStats sender;
+    UdpEndpointStats receiver;
+    uint64_t         received_bytes = 0;
+};
+
+static void Usage(const char *name) {
+    printf("Usage: %s [-s size] [-b size] [-q size] [-t seconds] [-g] [-r] "
+           "[-j]\n"
+           "  -s  Datagram size in bytes. Default 1200.\n"
+           "  -b  Bytes queued per send call. Default 65536.\n"
+           "  -q  Bytes the sender keeps queued. Default 1048576.\n"
+           "  -t  Benchmark duration in seconds. Default 5.\n"
+           "  -g  Send with segmentation offload (UDP_SEGMENT).\n"
+           "  -r  Receive with coalescing offload (UDP_GRO).\n"
+           "  -j  Print result as one JSON line.\n",
+           name);
+}
+
+/// Run @p fn in the loop thread and wait for it.
+static void RunAndWait(EventLoop &loop, const std::function<void()> &fn) {
+    std::promise<void> done;
+    loop.RunInLoop([&fn, &done]() {
+        fn();
+        done.set_value();
+    });
+    done.get_future().wait();
+}
+
+/// Refill the send queue and reschedule itself until @p stop is set.
+static void Pump(AsyncUdpEndpoint       *sender,
+                 const Options          &options,
+                 const std::string      &buffer,
+                 const InetAddr         &peer,
+                 const std::atomic_bool &stop) {
+    if (stop.load(std::memory_order_relaxed))
+        return;
+
+    while (sender->GetSendQueueBytes() < options.queue_size) {
+        if (options.gso) {
+            sender->AsyncSendSegments(
+                buffer.data(), buffer.size(), options.datagram_size, peer);
+        } else {
+            for (size_t offset = 0; offset < buffer.size();
+                 offset += options.datagram_size) {
+                size_t size = std::min(options.datagram_size,
+                                       buffer.size() - offset);
+                sender->AsyncSendTo(buffer.data() + offset, size, peer);
+            }
+        }
+    }
+
+    sender->GetLoop().QueueInLoop([sender, &options, &buffer, &peer, &stop]() {
+        Pump(sender, options, buffer, peer, stop);
+    });
+}
+
+int main(int argc, char **argv) {
+    Options options;
+
+    int opt;
+    while ((opt = ::getopt(argc, argv, "s:b:q:t:grjh")) != -1) {
+        switch (opt) {
+        case 's':
+            options.datagram_size = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'b':
+            options.buffer_size = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'q':
+            options.queue_size = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 't':
+            options.seconds = std::strtoul(optarg, nullptr, 10);
+            break;
+        case 'g':
+            options.gso = true;
+            break;
+        case 'r':
+            options.gro = true;
+            break;
+        case 'j':
+            options.json = true;
+            break;
+        default:
+            Usage(argv[0]);
+            return -10;
+        }
+    }
+
+    if (options.datagram_size == 0 || options.datagram_size > 65507 ||
+        options.buffer_size < options.datagram_size) {
+        Usage(argv[0]);
+        return -10;
+    }
+
+    EventLoopThread receiver_thread;
+    EventLoopThread sender_thread;
+    EventLoop      &receiver_loop = *receiver_thread.StartLoop();
+    EventLoop      &sender_loop   = *sender_thread.StartLoop();
+
+    UdpSocket receiver_socket(InetAddr::Ipv4Loopback(0));
+    UdpSocket sender_socket(InetAddr::Ipv4Loopback(0));
+    if (!receiver_socket.IsValid() || !sender_socket.IsValid()) {
+        fprintf(stderr, "Failed to create UDP sockets.\n");
+        return -1;
+    }
+    receiver_socket.SetReceiveBufferSize(4 * 1024 * 1024);
+    sender_socket.SetSendBufferSize(4 * 1024 * 1024);
+
+    InetAddr peer;
+    if (!receiver_socket.GetLocalAddr(peer)) {
+        fprintf(stderr, "Failed to get receiver address.\n");
+        return -1;
+    }
+
+    // Endpoints must be created and destroyed in their loop threads.
+    std::unique_ptr<AsyncUdpEndpoint> receiver;
+    std::unique_ptr<AsyncUdpEndpoint> sender;
+    uint64_t                          received_bytes = 0;
+
+    bool gro_enabled = true;
+    RunAndWait(receiver_loop, [&]() {
+        receiver.reset(new AsyncUdpEndpoint(receiver_loop,
+                                            std::move(receiver_socket)));
+        receiver->SetMessageCallback(
+            [&received_bytes](AsyncUdpEndpoint *,
+                              const UdpDatagram *datagrams,
+                              size_t             count) {
+                for (size_t i = 0; i < count; ++i)
+                    received_bytes += datagrams[i].size;
+            });
+        if (options.gro)
+            gro_enabled = receiver->EnableReceiveOffload();
+    });
+
+    if (!gro_enabled) {
+        fprintf(stderr, "UDP_GRO is not supported.\n");
+        RunAndWait(receiver_loop, [&]() { receiver.reset(); });
+        return -1;
+    }
+
+    const std::string buffer(options.buffer_size, 'x');
+    std::atomic_bool  stop(false);
+    RunAndWait(sender_loop, [&]() {
+        sender.reset(
+            new AsyncUdpEndpoint(sender_loop, std::move(sender_socket)));
+        Pump(sender.get(), options, buffer, peer, stop);
+    });
+
+    // Sample in two steps, each in its own loop thread.
+    auto take_sample = [&]() {
+        Sample sample;
+        RunAndWait(sender_loop, [&]() { sample.sender = sender->GetStats(); });
+        RunAndWait(receiver_loop, [&]() {
+            sample.receiver       = receiver->GetStats();
+            sample.received_bytes = received_bytes;
+        });
+        return sample;
+    };
+
+    // Let the queues fill up before measuring.
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto   start = std::chrono::steady_clock::now();
+    Sample begin = take_sample();
+
+    std::this_thread::sleep_for(std::chrono::seconds(options.seconds));
+
+    Sample end = take_sample();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    stop.store(true, std::memory_order_relaxed);
+    RunAndWait(sender_loop, [&]() { sender.reset(); });
+    RunAndWait(receiver_loop, [&]() { receiver.reset(); });
+
+    double seconds = elapsed.count();
+    double sent    = static_cast<double>(end.sender.num_sent -
+                                         begin.sender.num_sent);
+    double send_calls = static_cast<double>(end.sender.num_send_calls -
+                                            begin.sender.num_send_calls);
+    double received = static_cast<double>(end.receiver.num_received -
+                                          begin.receiver.num_received);
+    double receive_calls = static_cast<double>(
+        end.receiver.num_receive_calls - begin.receiver.num_receive_calls);
+    double mib = static_cast<double>(end.received_bytes -
+                                     begin.received_bytes) /
+                 (1024.0 * 1024.0);
+    double loss = (sent > 0 && sent > received) ? (sent - received) / sent
+                                                : 0.0;
+
+    send_calls    = std::max(send_calls, 1.0);
+    receive_calls = std::max(receive_calls, 1.0);
+
+    if (options.json) {
+        printf("{\"benchmark\":\"udp_stream\",\"version\":\"%s\","
+               "\"datagram_size\":%zu,\"buffer_size\":%zu,\"gso\":%s,"
+               "\"gro\":%s,\"seconds\":%.3f,\"sent_per_sec\":%.0f,"
+               "\"received_per_sec\":%.0f,\"mib_per_sec\":%.2f,"
+               "\"datagrams_per_send_call\":%.2f,"
+               "\"datagrams_per_receive_call\":%.2f,\"loss\":%.4f}\n",
+               EVEIO_VERSION, options.datagram_size, options.buffer_size,
+               options.gso ? "true" : "false", options.gro ? "true" : "false",
+               seconds, sent / seconds, received / seconds, mib / seconds,
+               sent / send_calls, received / receive_calls, loss);
+        return 0;
+    }
+
+    printf("eveio %s udp stream: %zu byte datagrams, gso %s, gro %s, "
+           "%.2f seconds\n",
+           EVEIO_VERSION, options.datagram_size, options.gso ? "on" : "off",
+           options.gro ? "on" : "off", seconds);
+    printf("  sent:     %12.0f datagrams/s, %8.2f datagrams/call\n",
+           sent / seconds, sent / send_calls);
+    printf("  received: %12.0f datagrams/s, %8.2f datagrams/call, "
+           "%.2f MiB/s\n",
+           received / seconds, received / receive_calls, mib / seconds);
+    printf("  loss:     %11.2f%%\n", loss * 100.0);
+    return 0;
+}
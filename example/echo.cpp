@@ -5,16 +5,18 @@ using eveio::AsyncTcpConnection;
 using eveio::EventLoop;
 using eveio::InetAddr;
 using eveio::TcpServer;
+using eveio::UnixAddr;
 
 class EchoTcpServer {
 public:
-    EchoTcpServer(EventLoop &loop, const InetAddr &addr)
-        : m_server(loop, addr) {
+    /// @p addr is either an InetAddr or a UnixAddr. The handlers are the
+    /// same for both.
+    template <typename Addr>
+    EchoTcpServer(EventLoop &loop, const Addr &addr) : m_server(loop, addr) {
         m_server.SetConnectionCallback([](AsyncTcpConnection *) {});
         m_server.SetMessageCallback(
             [](AsyncTcpConnection *conn, AsyncTcpConnBuffer &buffer) {
-                auto data = buffer.RetrieveAsString();
-                conn->AsyncSend(data.data(), data.size());
+                conn->AsyncSend(buffer.RetrieveAsString());
             });
     }
 
@@ -26,15 +28,34 @@ private:
 
 int main(int argc, char **argv) {
     if (argc < 2) {
-        printf("Usage: %s port\n", argv[0]);
+        printf("Usage: %s port|path\n"
+               "  A path starting with '/' or '.' listens on an AF_UNIX\n"
+               "  socket, '@' on an abstract AF_UNIX name.\n",
+               argv[0]);
         return -10;
     }
 
+    EventLoop loop;
+
+    const std::string target = argv[1];
+    if (target[0] == '/' || target[0] == '.' || target[0] == '@') {
+        UnixAddr addr = UnixAddr::Parse(target);
+        if (!addr.IsValid()) {
+            printf("Invalid path %s\n", target.c_str());
+            return -10;
+        }
+
+        if (!addr.IsAbstract())
+            ::unlink(target.c_str());
+        EchoTcpServer server(loop, addr);
+        server.Start();
+        loop.Loop();
+        return 0;
+    }
+
     auto port = static_cast<uint16_t>(atoi(argv[1]));
 
-    EventLoop     loop;
-    auto          addr = InetAddr::Ipv4Any(port);
-    EchoTcpServer server(loop, addr);
+    EchoTcpServer server(loop, InetAddr::Ipv4Any(port));
     server.Start();
     loop.Loop();
     return 0;
@@ -0,0 +1,153 @@
+/// Echo server that could be restarted without dropping any connection.
+///
+/// Every instance accepts on a control address. A new instance first connects
+/// there: if an old one answers, it takes over the listening socket and all
+/// idle connections of the old one, otherwise it starts cold. The old
+/// instance stops accepting at once, serves the connections that were still
+/// sending for a grace period and then exits.
+///
+///   $ ./eveio_hot_restart 8080 &
+///   $ ./eveio_hot_restart 8080 &   # takes over from the first one
+#include "eveio/Handoff.h"
+#include "eveio/TcpServer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+using eveio::Acceptor;
+using eveio::AsyncTcpConnBuffer;
+using eveio::AsyncTcpConnection;
+using eveio::EventLoop;
+using eveio::HandoffItem;
+using eveio::HandoffReceiver;
+using eveio::HandoffSender;
+using eveio::InetAddr;
+using eveio::TcpConnection;
+using eveio::TcpServer;
+using eveio::TcpSocket;
+using eveio::UnixAddr;
+
+static constexpr const char *LISTENER_NAME   = "echo";
+static constexpr const char *CONNECTION_NAME = "echo";
+
+static void Echo(AsyncTcpConnection *conn, AsyncTcpConnBuffer &buffer) {
+    conn->AsyncSend(buffer.RetrieveAsString());
+}
+
+/// Take over from a running instance. Returns nullptr if there is none.
+static std::unique_ptr<TcpServer> TakeOver(EventLoop      &loop,
+                                           const UnixAddr &control) {
+    TcpConnection conn(control);
+    if (!conn.IsValid())
+        return nullptr;
+
+    HandoffReceiver receiver(std::move(conn));
+
+    std::unique_ptr<TcpServer> server;
+    std::vector<HandoffItem>   connections;
+
+    HandoffItem item;
+    while (receiver.Receive(item)) {
+        if (item.kind == HandoffItem::KIND_LISTENER && !server) {
+            server.reset(new TcpServer(loop, TcpSocket(item.sock)));
+        } else if (item.kind == HandoffItem::KIND_CONNECTION) {
+            connections.push_back(std::move(item));
+        } else {
+            eveio::socket::close(item.sock);
+        }
+        item = HandoffItem();
+    }
+
+    if (!receiver.IsFinished() || !server) {
+        printf("Hot restart failed.\n");
+        std::exit(-1);
+    }
+
+    server->SetMessageCallback(Echo);
+    server->Start();
+
+    for (HandoffItem &taken : connections)
+        server->AdoptConnection(TcpConnection(taken.sock),
+                                std::move(taken.data));
+
+    printf("Took over %zu connections.\n", connections.size());
+    return server;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s port [control]\n"
+               "  control  Abstract AF_UNIX name or path to hand off on.\n"
+               "           Default @eveio-hot-restart.\n",
+               argv[0]);
+        return -10;
+    }
+
+    auto     port    = static_cast<uint16_t>(atoi(argv[1]));
+    UnixAddr control = UnixAddr::Parse(argc > 2 ? argv[2]
+                                                : "@eveio-hot-restart");
+    if (!control.IsValid()) {
+        printf("Invalid control address.\n");
+        return -10;
+    }
+
+    EventLoop loop;
+
+    std::unique_ptr<TcpServer> server = TakeOver(loop, control);
+    if (!server) {
+        server.reset(new TcpServer(loop, InetAddr::Ipv4Any(port)));
+        server->SetMessageCallback(Echo);
+        server->Start();
+        printf("Started cold on port %u.\n", static_cast<unsigned>(port));
+    }
+
+    // The previous instance has released the control address by now.
+    if (!control.IsAbstract())
+        ::unlink(control.GetPath().c_str());
+
+    std::unique_ptr<Acceptor> acceptor(new Acceptor(loop, control));
+    std::thread               handoff;
+
+    acceptor->SetNewConnectionCallback([&](TcpConnection &&conn) {
+        // Release the control address before the listener is sent, so that
+        // the new instance could bind it right after taking over.
+        loop.QueueInLoop([&acceptor]() { acceptor.reset(); });
+
+        // Handing off waits for the acceptor and worker loops, so it must run
+        // in its own thread.
+        auto sender = std::make_shared<HandoffSender>(std::move(conn));
+        handoff     = std::thread([&loop, &server, sender]() {
+            if (!server->HandOffListener(*sender, LISTENER_NAME)) {
+                printf("Failed to hand off listener.\n");
+                return;
+            }
+
+            size_t count =
+                server->HandOffIdleConnections(*sender, CONNECTION_NAME);
+            sender->Finish();
+            printf("Handed off %zu connections.\n", count);
+
+            loop.RunInLoop([&loop]() {
+                loop.RunAfter(std::chrono::seconds(5), [&loop]() {
+                    loop.Quit();
+                });
+            });
+        });
+    });
+
+    if (!acceptor->Listen()) {
+        printf("Failed to listen on control address.\n");
+        return -1;
+    }
+
+    loop.Loop();
+
+    if (handoff.joinable())
+        handoff.join();
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include "eveio/AsyncUdpEndpoint.h"
+#include "eveio/EventLoopThreadPool.h"
+
+using eveio::AsyncUdpEndpoint;
+using eveio::EventLoop;
+using eveio::EventLoopThreadPool;
+using eveio::InetAddr;
+using eveio::UdpDatagram;
+using eveio::UdpSocket;
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s port [threads]\n", argv[0]);
+        return -10;
+    }
+
+    auto port = static_cast<uint16_t>(atoi(argv[1]));
+    auto addr = InetAddr::Ipv4Any(port);
+
+    EventLoop           loop;
+    EventLoopThreadPool pool(argc > 2 ? static_cast<size_t>(atoi(argv[2]))
+                                      : 4);
+    pool.Start();
+
+    // One socket per worker loop. SO_REUSEPORT spreads datagrams among them.
+    std::vector<std::unique_ptr<AsyncUdpEndpoint>> endpoints;
+    for (EventLoop *worker : pool.GetAllLoops()) {
+        UdpSocket socket(addr, true);
+        if (!socket.IsValid()) {
+            printf("Failed to bind %s\n", addr.GetIpWithPort().c_str());
+            return -1;
+        }
+        socket.SetReceiveBufferSize(4 * 1024 * 1024);
+
+        endpoints.emplace_back(
+            new AsyncUdpEndpoint(*worker, std::move(socket)));
+
+        // Coalesced datagrams are echoed back with the same segment size, so
+        // the peer sees the original datagram boundaries.
+        endpoints.back()->EnableReceiveOffload();
+        endpoints.back()->SetMessageCallback(
+            [](AsyncUdpEndpoint  *endpoint,
+               const UdpDatagram *datagrams,
+               size_t             count) {
+                for (size_t i = 0; i < count; ++i)
+                    endpoint->AsyncSendSegments(datagrams[i].data,
+                                                datagrams[i].size,
+                                                datagrams[i].segment_size,
+                                                datagrams[i].peer);
+            });
+    }
+
+    loop.Loop();
+    return 0;
+}
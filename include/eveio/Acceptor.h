@@ -13,7 +13,14 @@ class Acceptor {
 public:
     using NewConnectionCallback = std::function<void(TcpConnection &&)>;
 
-    Acceptor(EventLoop &loop, const InetAddr &local_addr);
+    Acceptor(EventLoop &loop, const InetAddr &local_addr)
+        : Acceptor(loop, TcpSocket(local_addr)) {}
+
+    Acceptor(EventLoop &loop, const UnixAddr &local_addr)
+        : Acceptor(loop, TcpSocket(local_addr)) {}
+
+    /// Accept connections on a bound socket.
+    Acceptor(EventLoop &loop, TcpSocket &&socket);
     ~Acceptor();
 
     Acceptor(const Acceptor &) = delete;
@@ -30,10 +37,16 @@ public:
 
     bool IsListening() const noexcept { return m_is_listening; }
 
+    socket_t GetSocket() const noexcept { return m_socket.GetSocket(); }
+
     bool GetLocalAddr(InetAddr &addr) const noexcept {
         return m_socket.GetLocalAddr(addr);
     }
 
+    bool GetLocalAddr(UnixAddr &addr) const noexcept {
+        return m_socket.GetLocalAddr(addr);
+    }
+
     void Quit() {
         m_listener.DisableAll();
         m_listener.Unregister();
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "eveio/AsyncTcpConnection.h"
+#include "eveio/ShmChannel.h"
+
+#if EVEIO_HAS_SHM_RING
+
+namespace eveio {
+
+class AsyncShmConnection;
+
+using ShmMessageCallback =
+    std::function<void(AsyncShmConnection *, AsyncTcpConnBuffer &)>;
+using ShmWriteCompleteCallback = std::function<void(AsyncShmConnection *)>;
+using ShmConnectionCallback    = std::function<void(AsyncShmConnection *)>;
+
+/// ShmChannel driven by an EventLoop.
+///
+/// The interface follows AsyncTcpConnection, so a handler written as a
+/// template over the connection type could serve both transports:
+///   template <typename Conn>
+///   void OnMessage(Conn *conn, AsyncTcpConnBuffer &buffer);
+///
+/// Sends are copied straight into the shared ring. Whatever does not fit is
+/// queued and flushed once the peer frees some space. Each wakeup drains the
+/// incoming ring into the read buffer and calls the message callback once.
+/// The connection is destroyed once the peer closes its end.
+///
+/// Callbacks must be set before any data arrives or in the loop thread, and
+/// not from inside a callback. Create connections with new; they are
+/// deleted by Destroy().
+class AsyncShmConnection {
+public:
+    AsyncShmConnection(EventLoop &loop, ShmChannel &&channel);
+    ~AsyncShmConnection();
+
+    AsyncShmConnection(const AsyncShmConnection &) = delete;
+    AsyncShmConnection &operator=(const AsyncShmConnection &) = delete;
+
+    AsyncShmConnection(AsyncShmConnection &&) = delete;
+    AsyncShmConnection &operator=(AsyncShmConnection &&) = delete;
+
+    void SetMessageCallback(ShmMessageCallback cb) {
+        m_msg_callback = std::move(cb);
+    }
+
+    void SetWriteCompleteCallback(ShmWriteCompleteCallback cb) {
+        m_write_complete_callback = std::move(cb);
+    }
+
+    /// Called in loop thread right before the connection is deleted.
+    void SetCloseCallback(ShmConnectionCallback cb) {
+        m_close_callback = std::move(cb);
+    }
+
+    /// Data received but not consumed yet. Only use it in loop thread.
+    AsyncTcpConnBuffer &GetReadBuffer() noexcept { return m_read_buffer; }
+
+    /// Bytes waiting for free space in the ring. Only call in loop thread.
+    size_t GetWriteQueueSize() const noexcept { return m_write_buffer.Size(); }
+
+    /// Number of times the peer had to wake this side. Only call in loop
+    /// thread.
+    uint64_t GetWakeupCount() const noexcept { return m_num_wakeups; }
+
+    EventLoop &GetLoop() const noexcept { return *m_loop; }
+
+    void AsyncSend(const void *data, size_t size) noexcept;
+
+    /// Gather version of AsyncSend().
+    void AsyncSend(const struct iovec *vec, int count) noexcept;
+
+    /// Take ownership of @p data. Saves a copy if called from another thread.
+    void AsyncSend(std::string &&data) noexcept;
+
+    void Destroy() noexcept;
+
+    bool IsDestroying() const noexcept {
+        return m_is_quit.load(std::memory_order_relaxed);
+    }
+
+private:
+    void HandleWakeup() noexcept;
+    void HandleRead() noexcept;
+    void HandleSocketRead() noexcept;
+    void SendInLoop(const struct iovec *vec, int count) noexcept;
+    void Flush() noexcept;
+
+private:
+    EventLoop *const m_loop;
+    ShmChannel       m_channel;
+    Listener         m_notify_listener;
+    Listener         m_socket_listener;
+
+    ShmMessageCallback       m_msg_callback;
+    ShmWriteCompleteCallback m_write_complete_callback;
+    ShmConnectionCallback    m_close_callback;
+
+    AsyncTcpConnBuffer m_read_buffer;
+    AsyncTcpConnBuffer m_write_buffer;
+
+    uint64_t         m_num_wakeups;
+    std::atomic_bool m_is_quit;
+};
+
+} // namespace eveio
+
+#endif // EVEIO_HAS_SHM_RING
@@ -1,44 +1,64 @@
 #pragma once
 
+#include "eveio/BufferPool.h"
+#include "eveio/ConnectionStats.h"
 #include "eveio/EventLoop.h"
 #include "eveio/Listener.h"
+#include "eveio/SharedBuffer.h"
+#include "eveio/TcpConnectionHandle.h"
 #include "eveio/TcpSocket.h"
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
 namespace eveio {
 
+/// Connection buffer backed by blocks from the loop BufferPool.
+///
+/// Storage is attached lazily on the first write and handed back to the pool
+/// as soon as the buffer drains, so idle connections do not hold any buffer
+/// memory.
 class AsyncTcpConnBuffer {
 public:
-    AsyncTcpConnBuffer()  = default;
-    ~AsyncTcpConnBuffer() = default;
+    AsyncTcpConnBuffer() noexcept = default;
+    AsyncTcpConnBuffer(BufferPool *pool, BufferPool::Category category) noexcept
+        : m_pool(pool), m_category(category) {}
 
-    AsyncTcpConnBuffer(const AsyncTcpConnBuffer &) = default;
-    AsyncTcpConnBuffer &operator=(const AsyncTcpConnBuffer &) = default;
+    ~AsyncTcpConnBuffer() { Release(); }
 
-    AsyncTcpConnBuffer(AsyncTcpConnBuffer &&) = default;
-    AsyncTcpConnBuffer &operator=(AsyncTcpConnBuffer &&) = default;
+    AsyncTcpConnBuffer(const AsyncTcpConnBuffer &) = delete;
+    AsyncTcpConnBuffer &operator=(const AsyncTcpConnBuffer &) = delete;
+
+    AsyncTcpConnBuffer(AsyncTcpConnBuffer &&other) noexcept;
+    AsyncTcpConnBuffer &operator=(AsyncTcpConnBuffer &&other) noexcept;
 
     template <typename T>
     T *Data() noexcept {
-        return reinterpret_cast<T *>(m_storage.data() + m_head);
+        return reinterpret_cast<T *>(m_storage + m_head);
     }
 
     template <typename T>
     const T *Data() const noexcept {
-        return reinterpret_cast<const T *>(m_storage.data() + m_head);
+        return reinterpret_cast<const T *>(m_storage + m_head);
     }
 
-    void Clear() noexcept { m_head = m_tail = 0; }
+    /// Drop all data and give the storage back to the pool.
+    void Clear() noexcept { Release(); }
 
     size_t Size() const noexcept { return (m_tail - m_head); }
-    size_t Capacity() const noexcept { return (m_storage.capacity() - m_tail); }
+    size_t Capacity() const noexcept { return (m_capacity - m_tail); }
 
     bool IsEmpty() const noexcept { return (Size() == 0); }
 
-    /// This method only moves the buffer pointer.
+    /// Whether this buffer currently holds a block from the pool.
+    bool HasStorage() const noexcept { return m_storage != nullptr; }
+
+    /// This method only moves the buffer pointer. Storage is released once all
+    /// data is read out.
     void ReadOut(size_t size) noexcept {
         m_head += size;
         if (m_head >= m_tail) {
@@ -54,13 +74,26 @@ public:
 
     void Append(const void *data, size_t size) noexcept;
 
+    /// Make sure that at least @p size bytes could be written after the tail.
+    bool Reserve(size_t size) noexcept;
+
+    /// Writable area after the tail. Call HasWritten() after filling it.
+    char *WritableData() noexcept { return m_storage + m_tail; }
+    void  HasWritten(size_t size) noexcept { m_tail += size; }
+
     char  operator[](size_t i) const noexcept { return Data<char>()[i]; }
     char &operator[](size_t i) noexcept { return Data<char>()[i]; }
 
 private:
-    std::vector<char> m_storage;
-    size_t            m_head = 0;
-    size_t            m_tail = 0;
+    void Release() noexcept;
+
+private:
+    BufferPool          *m_pool     = nullptr;
+    BufferPool::Category m_category = BufferPool::CATEGORY_READ;
+    char                *m_storage  = nullptr;
+    size_t               m_capacity = 0;
+    size_t               m_head     = 0;
+    size_t               m_tail     = 0;
 };
 
 class AsyncTcpConnection;
@@ -70,31 +103,172 @@ using TcpMessageCallback =
 using TcpWriteCompleteCallback = std::function<void(AsyncTcpConnection *)>;
 using TcpConnectionCallback    = std::function<void(AsyncTcpConnection *)>;
 
+/// Called with the number of bytes waiting in the write queue.
+using TcpWaterMarkCallback =
+    std::function<void(AsyncTcpConnection *, size_t)>;
+
+/// Callbacks of a connection. TcpServer shares one instance between all
+/// connections of a loop instead of copying every callback into each of them.
+struct TcpConnectionCallbacks {
+    TcpMessageCallback       msg_callback;
+    TcpWriteCompleteCallback write_complete_callback;
+    TcpWaterMarkCallback     high_water_mark_callback;
+    TcpWaterMarkCallback     low_water_mark_callback;
+    TcpConnectionCallback    close_callback;
+};
+
 class AsyncTcpConnection {
 public:
+    static constexpr const size_t DEFAULT_ZEROCOPY_THRESHOLD = 16 * 1024;
+    static constexpr const size_t DEFAULT_HIGH_WATER_MARK = 64 * 1024 * 1024;
+    static constexpr const size_t DEFAULT_LOW_WATER_MARK  = 16 * 1024 * 1024;
+    static constexpr const size_t DEFAULT_READ_BUDGET_BYTES = 1024 * 1024;
+    static constexpr const size_t DEFAULT_READ_BUDGET_CALLS = 16;
+
     AsyncTcpConnection(EventLoop &loop, TcpConnection &&conn);
     ~AsyncTcpConnection();
 
+    /// Create a connection with memory recycled from the connection pool of
+    /// @p loop. Falls back to plain new if not called in the loop thread.
+    /// Either way the connection is freed by Destroy().
+    static AsyncTcpConnection *Create(EventLoop &loop, TcpConnection &&conn);
+
     AsyncTcpConnection(const AsyncTcpConnection &) noexcept = delete;
     AsyncTcpConnection &operator=(const AsyncTcpConnection &) noexcept = delete;
 
     AsyncTcpConnection(AsyncTcpConnection &&) noexcept = delete;
     AsyncTcpConnection &operator=(AsyncTcpConnection &&) noexcept = delete;
 
+    /// Use a callback set shared with other connections. Setting a single
+    /// callback afterwards makes a private copy of the set first.
+    void SetCallbacks(std::shared_ptr<const TcpConnectionCallbacks> cbs) {
+        m_callbacks      = std::move(cbs);
+        m_owns_callbacks = false;
+    }
+
     void SetMessageCallback(TcpMessageCallback cb) {
-        m_msg_callback = std::move(cb);
+        MutableCallbacks().msg_callback = std::move(cb);
     }
 
     void SetWriteCompleteCallback(TcpWriteCompleteCallback cb) {
-        m_write_complete_callback = std::move(cb);
+        MutableCallbacks().write_complete_callback = std::move(cb);
+    }
+
+    /// Called in loop thread right before the connection is deleted.
+    void SetCloseCallback(TcpConnectionCallback cb) {
+        MutableCallbacks().close_callback = std::move(cb);
+    }
+
+    /// For internal usage. Called in loop thread right before the close
+    /// callback. Unlike the callback set, it is not replaced by any of the
+    /// setters above, so owners like TcpServer could always unregister the
+    /// connection.
+    void SetDestroyHook(std::shared_ptr<const TcpConnectionCallback> hook) {
+        m_destroy_hook = std::move(hook);
+    }
+
+    /// Called once the write queue grows to @p mark bytes or more. It is not
+    /// called again until the queue falls back to the low water mark.
+    void SetHighWaterMarkCallback(TcpWaterMarkCallback cb,
+                                  size_t mark = DEFAULT_HIGH_WATER_MARK) {
+        MutableCallbacks().high_water_mark_callback = std::move(cb);
+        m_high_water_mark                           = mark;
+    }
+
+    /// Called once the write queue falls to @p mark bytes or less after the
+    /// high water mark was reached.
+    void SetLowWaterMarkCallback(TcpWaterMarkCallback cb,
+                                 size_t mark = DEFAULT_LOW_WATER_MARK) {
+        MutableCallbacks().low_water_mark_callback = std::move(cb);
+        m_low_water_mark                           = mark;
+    }
+
+    /// Set both water marks without touching the callbacks.
+    void SetWaterMarks(size_t high, size_t low) noexcept {
+        m_high_water_mark = high;
+        m_low_water_mark  = low;
+    }
+
+    /// Stop reading from this connection while its write queue is above the
+    /// high water mark. This bounds memory of request-response protocols where
+    /// the peer sends faster than it receives.
+    void SetPauseReadingOnHighWaterMark(bool on) noexcept {
+        m_pause_on_high_water_mark = on;
+    }
+
+    /// Limit bytes and recv syscalls per read event, so that a single busy
+    /// connection could not starve other connections in the same loop. Data
+    /// left in the socket is read in the next loop iteration. The message
+    /// callback is called once per read event.
+    void SetReadBudget(size_t max_bytes, size_t max_calls) noexcept {
+        m_read_budget_bytes = std::max(max_bytes, size_t(1));
+        m_read_budget_calls = std::max(max_calls, size_t(1));
+    }
+
+    /// Stop reading once @p size bytes are waiting in the read buffer. Reading
+    /// resumes automatically once the message callback consumes some data, or
+    /// when ResumeReading() is called after consuming data from
+    /// GetReadBuffer(). Unlimited by default.
+    void SetMaxReadBufferSize(size_t size) noexcept {
+        m_max_read_buffer_size = std::max(size, size_t(1));
+    }
+
+    /// Data received but not consumed yet. Only use it in loop thread.
+    AsyncTcpConnBuffer &GetReadBuffer() noexcept { return m_read_buffer; }
+
+    /// Number of times reading was paused because the read buffer was full.
+    uint64_t GetReadBufferFullCount() const noexcept {
+        return m_read_buffer_full_count;
     }
 
+    /// Coalesce sends issued in loop thread until the end of current loop
+    /// iteration. All data queued during event dispatch is then flushed with a
+    /// single writev(), which saves syscalls and small TCP segments for
+    /// pipelined protocols. Sends from other threads are flushed after pending
+    /// functions are done.
+    void SetAutoCork(bool on) noexcept { m_auto_cork = on; }
+
+    /// EventLoop::GetCoarseTime() of the last successful read or write. Only
+    /// call in loop thread.
+    int64_t GetLastActiveTime() const noexcept { return m_last_active; }
+
+    /// I/O counters of this connection. All zero unless built with
+    /// EVEIO_ENABLE_CONN_STATS. Only call in loop thread.
+    TcpConnectionStats GetStats() const noexcept { return m_stats.Get(); }
+
+    /// Bytes waiting in the write queue. Only call in loop thread.
+    size_t GetWriteQueueSize() const noexcept { return m_write_queue_bytes; }
+
+    /// Stop listening for incoming data. Could be called from any thread.
+    /// Proxies could pause the upstream connection in the high water mark
+    /// callback of the downstream one, and resume it in the low water mark
+    /// callback.
+    void PauseReading() noexcept;
+
+    /// Resume reading paused by PauseReading() or by a full read buffer.
+    void ResumeReading() noexcept;
+
     EventLoop &GetLoop() const noexcept { return *m_loop; }
 
+    /// Handle that could be kept by other threads instead of this pointer.
+    /// It is null until the connection is registered in its loop thread.
+    /// Connections created by TcpServer are registered before the connection
+    /// callback. Only call in loop thread.
+    TcpConnectionHandle GetHandle() const noexcept {
+        if (m_slot == ConnectionTable::INVALID_SLOT ||
+            m_loop->GetIndex() == EventLoop::INVALID_INDEX)
+            return TcpConnectionHandle();
+        return TcpConnectionHandle(m_loop->GetIndex(), m_slot, m_generation);
+    }
+
     bool GetPeerAddr(InetAddr &addr) const noexcept {
         return m_conn.GetPeerAddr(addr);
     }
 
+    bool GetPeerAddr(UnixAddr &addr) const noexcept {
+        return m_conn.GetPeerAddr(addr);
+    }
+
     bool ShutdownWrite() noexcept { return m_conn.ShutdownWrite(); }
 
     bool SetNoDelay(bool on) noexcept { return m_conn.SetNoDelay(on); }
@@ -102,8 +276,65 @@ public:
 
     void AsyncSend(const void *data, size_t size) noexcept;
 
+    /// Gather version of AsyncSend(). Useful to send a header and a payload
+    /// without concatenating them first.
+    void AsyncSend(const struct iovec *vec, int count) noexcept;
+
+    /// Take ownership of @p data. The bytes are handed to the kernel from the
+    /// string itself and are never copied into the write buffer.
+    void AsyncSend(std::string &&data) noexcept;
+
+    /// Take ownership of @p data. The bytes are handed to the kernel from the
+    /// vector itself and are never copied into the write buffer.
+    void AsyncSend(std::vector<char> &&data) noexcept;
+
+    /// Queue a reference of @p data. The buffer is kept alive until it is sent.
+    void AsyncSend(const SharedBuffer &data) noexcept;
+
+    /// Send @p length bytes of file @p fd starting at @p offset with
+    /// sendfile(). A length of 0 means until the end of file.
+    ///
+    /// The file descriptor is duplicated, so the caller could close @p fd once
+    /// this method returns. The region is sent in order with other AsyncSend
+    /// calls and write complete callback is called once the write queue
+    /// drains. Returns false if @p fd is not a regular file, if the region
+    /// does not fit in the file, or if failed to duplicate @p fd.
+    bool AsyncSendFile(int fd, int64_t offset, size_t length = 0) noexcept;
+
+    /// Send owned payloads (std::string&&, std::vector<char>&& and
+    /// SharedBuffer) of at least @p threshold bytes with MSG_ZEROCOPY. Payloads
+    /// are pinned until the kernel reports completion through the socket error
+    /// queue.
+    ///
+    /// Zero copy is turned off automatically once the kernel reports that it
+    /// copied the data anyway, for example over loopback. Returns false if
+    /// zero copy is not supported.
+    bool SetZeroCopy(bool   on,
+                     size_t threshold = DEFAULT_ZEROCOPY_THRESHOLD) noexcept;
+
+    /// Whether new sends may use zero copy. Only call in loop thread.
+    bool IsZeroCopy() const noexcept { return m_zerocopy; }
+
+    /// Number of zero copy sends waiting for kernel completion. Only call in
+    /// loop thread.
+    size_t GetZeroCopyPendingCount() const noexcept {
+        return m_zerocopy_pending.size();
+    }
+
     void Destroy() noexcept;
 
+    /// Give up the socket and destroy this connection without closing it, so
+    /// that the socket could be handed to another process. Unconsumed input
+    /// is moved to @p buffered. Fails and returns INVALID_SOCKET if there is
+    /// data waiting to be sent. The caller owns the returned socket. Only
+    /// call in loop thread.
+    socket_t Detach(std::string &buffered) noexcept;
+
+    /// Handle @p data as if it was just read from the socket: append it to the
+    /// read buffer and call the message callback. Used to resume input of a
+    /// connection detached in another process. Only call in loop thread.
+    void InjectReceived(const void *data, size_t size) noexcept;
+
     /// Use this to detect if current connection is destroying.
     /// DO NOT pend current connection at event loop func queue if this
     /// connection is destroying.
@@ -112,20 +343,132 @@ public:
     }
 
 private:
+    friend class IdleConnectionWheel;
+
+    /// A write queue entry. A segment is one of:
+    /// - a file region if @p file is valid. @p offset is the file offset;
+    /// - a shared buffer if @p buffer is not null;
+    /// - otherwise the next @p size bytes in m_write_buffer.
+    struct WriteSegment {
+        SharedBuffer buffer;
+        size_t       offset;
+        size_t       size;
+        int          file;
+
+        bool IsFile() const noexcept { return file >= 0; }
+        bool IsCopied() const noexcept { return !IsFile() && buffer.IsNull(); }
+    };
+
+    struct ZeroCopyPending {
+        uint32_t     seq;
+        SharedBuffer buffer;
+    };
+
+    enum {
+        READ_PAUSED_BY_USER          = 0x01,
+        READ_PAUSED_BY_WRITE_BACKLOG = 0x02,
+        READ_PAUSED_BY_BUFFER_FULL   = 0x04,
+        READ_PAUSED_BY_MEMORY        = 0x08,
+    };
+
+    TcpConnectionCallbacks &MutableCallbacks();
+
     void HandleRead() noexcept;
     void SendInLoop() noexcept;
+    void HandleZeroCopyCompletion() noexcept;
+
+    void PauseReadingInLoop(uint32_t reason) noexcept;
+    void ResumeReadingInLoop(uint32_t reason) noexcept;
+
+    /// Pause or resume reading according to read buffer size.
+    void CheckReadBuffer() noexcept;
+
+    /// Pause reading until the process is below BufferPool process limit.
+    /// Returns false if the connection could not wait for it.
+    bool PauseReadingForMemory() noexcept;
+    void ScheduleMemoryRetry() noexcept;
+
+    /// Fire water mark callbacks if the write queue crossed a water mark.
+    void CheckWaterMarks() noexcept;
+
+    bool UseZeroCopy(size_t size) const noexcept {
+        return m_zerocopy && size >= m_zerocopy_threshold;
+    }
+
+    void SendInLoop(const void *data, size_t size) noexcept;
+    void SendInLoop(const struct iovec *vec, int count) noexcept;
+    void SendInLoop(SharedBuffer &&data) noexcept;
+
+    /// Send without queueing. Returns number of bytes sent, or -1 if the
+    /// connection is broken.
+    int64_t WriteDirect(const void *data, size_t size) noexcept;
+    int64_t WriteDirect(const struct iovec *vec,
+                        int                 count,
+                        size_t              total) noexcept;
+    void    QueueWrite(SharedBuffer &&data,
+                       size_t         offset,
+                       size_t         size) noexcept;
+    void    SendFileInLoop(int fd, int64_t offset, size_t length) noexcept;
+    void ConsumeWriteQueue(size_t size) noexcept;
+
+    /// Flush new data in the write queue, either now or at the end of this
+    /// loop iteration in auto cork mode.
+    void StartWrite() noexcept;
+
+    bool CanWriteDirect() const noexcept {
+        return !m_auto_cork && IsWriteQueueEmpty();
+    }
+
+    bool IsWriteQueueEmpty() const noexcept {
+        return m_write_queue_head == m_write_queue.size();
+    }
 
 private:
-    EventLoop *const         m_loop;
-    TcpConnection            m_conn;
-    Listener                 m_listener;
-    TcpMessageCallback       m_msg_callback;
-    TcpWriteCompleteCallback m_write_complete_callback;
+    EventLoop *const                              m_loop;
+    TcpConnection                                 m_conn;
+    Listener                                      m_listener;
+    std::shared_ptr<const TcpConnectionCallbacks> m_callbacks;
+    std::shared_ptr<const TcpConnectionCallback>  m_destroy_hook;
 
     AsyncTcpConnBuffer m_read_buffer;
     AsyncTcpConnBuffer m_write_buffer;
 
+    std::vector<WriteSegment> m_write_queue;
+    size_t                    m_write_queue_head;
+    size_t                    m_write_queue_bytes;
+
+    size_t   m_high_water_mark;
+    size_t   m_low_water_mark;
+    size_t   m_read_budget_bytes;
+    size_t   m_read_budget_calls;
+    size_t   m_max_read_buffer_size;
+    uint64_t m_read_buffer_full_count;
+
+    std::vector<ZeroCopyPending> m_zerocopy_pending;
+    size_t                       m_zerocopy_threshold;
+    uint32_t                     m_zerocopy_seq;
+    uint32_t                     m_read_paused;
+
+    /// Position in the idle wheel of the loop, if any.
+    int64_t  m_last_active;
+    uint32_t m_idle_bucket;
+    uint32_t m_idle_index;
+
+    /// Position in the connection table of the loop.
+    uint32_t m_slot;
+    uint32_t m_generation;
+
+    // Flags are grouped together to keep the object small.
+    bool             m_owns_callbacks;
+    bool             m_pause_on_high_water_mark;
+    bool             m_above_high_water_mark;
+    bool             m_auto_cork;
+    bool             m_flush_pending;
+    bool             m_zerocopy;
     std::atomic_bool m_is_quit;
+
+    /// Empty unless built with EVEIO_ENABLE_CONN_STATS.
+    TcpConnStatsRecorder m_stats;
 };
 
 } // namespace eveio
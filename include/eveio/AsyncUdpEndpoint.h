@@ -0,0 +1,215 @@
+#pragma once
+
+#include "eveio/EventLoop.h"
+#include "eveio/Listener.h"
+#include "eveio/UdpSocket.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace eveio {
+
+class AsyncUdpEndpoint;
+
+/// A received datagram. It points into the per-loop receive batch and is only
+/// valid during the message callback.
+///
+/// With receive offload enabled, the kernel may coalesce consecutive
+/// datagrams of one peer into a single buffer. Each of them is
+/// @p segment_size bytes except the last one, which could be shorter.
+struct UdpDatagram {
+    const char *data;
+    size_t      size;
+    size_t      segment_size;
+    InetAddr    peer;
+};
+
+using UdpMessageCallback = std::function<void(
+    AsyncUdpEndpoint *, const UdpDatagram *datagrams, size_t count)>;
+
+/// Called with errno when the kernel rejects a queued datagram to @p peer,
+/// e.g. ENOBUFS, ECONNREFUSED or EMSGSIZE. The datagram has been dropped.
+using UdpSendErrorCallback =
+    std::function<void(AsyncUdpEndpoint *, int error, const InetAddr &peer)>;
+
+struct UdpEndpointStats {
+    /// Number of datagrams received. Coalesced segments count one by one.
+    uint64_t num_received = 0;
+    /// Number of receive system calls that returned datagrams.
+    uint64_t num_receive_calls = 0;
+    /// Number of datagrams dropped because they exceeded the size limit.
+    uint64_t num_truncated = 0;
+    /// Number of datagrams handed to the kernel. Segments of one offloaded
+    /// buffer count one by one.
+    uint64_t num_sent = 0;
+    /// Number of send system calls.
+    uint64_t num_send_calls = 0;
+    /// Number of datagrams dropped because the send queue was full.
+    uint64_t num_dropped = 0;
+    /// Number of datagrams rejected by the kernel.
+    uint64_t num_send_errors = 0;
+};
+
+/// For internal usage. Scratch space for batched receiving and sending. Each
+/// EventLoop owns one, shared by all UDP endpoints of that loop.
+struct UdpMessageBatch {
+    /// Make room for @p count datagrams of @p size bytes each.
+    void Reserve(size_t count, size_t size);
+
+    size_t slot_size = 0;
+
+    std::vector<char>                buffer;
+    std::vector<struct iovec>        iovecs;
+    std::vector<struct sockaddr_in6> addrs;
+    std::vector<UdpDatagram>         datagrams;
+    std::vector<char>                control;
+#if EVEIO_HAS_MMSG
+    std::vector<struct mmsghdr> headers;
+#endif
+};
+
+/// Datagram endpoint driven by an EventLoop.
+///
+/// Each read event receives up to the batch size of datagrams with one
+/// recvmmsg() call and hands all of them to the message callback at once.
+/// Outgoing datagrams are queued and sent with sendmmsg() once the current
+/// batch of events is handled. If the socket buffer is full, datagrams stay
+/// queued until the socket is writable. New datagrams are dropped while the
+/// queue is over its byte limit.
+///
+/// With SO_REUSEPORT, create one endpoint per worker loop on the same
+/// address:
+///   for (EventLoop *loop : pool->GetAllLoops())
+///       endpoints.emplace_back(new AsyncUdpEndpoint(
+///           *loop, UdpSocket(addr, true)));
+///
+/// On Linux, AsyncSendSegments() passes a large buffer to the kernel with
+/// UDP_SEGMENT and lets it cut the buffer into datagrams.
+/// EnableReceiveOffload() turns on UDP_GRO, so that the callback may get
+/// coalesced datagrams.
+///
+/// Setters must be called before any datagram arrives or in the loop thread.
+/// The endpoint must be destroyed in the loop thread.
+class AsyncUdpEndpoint {
+public:
+    static constexpr const size_t DEFAULT_BATCH_SIZE        = 32;
+    static constexpr const size_t DEFAULT_MAX_DATAGRAM_SIZE = 2048;
+    static constexpr const size_t DEFAULT_MAX_SEND_QUEUE    = 4 * 1024 * 1024;
+
+    /// Largest buffer the kernel could coalesce datagrams into.
+    static constexpr const size_t MAX_COALESCED_SIZE = 65535;
+
+    AsyncUdpEndpoint(EventLoop &loop, UdpSocket &&socket);
+    ~AsyncUdpEndpoint();
+
+    AsyncUdpEndpoint(const AsyncUdpEndpoint &) = delete;
+    AsyncUdpEndpoint &operator=(const AsyncUdpEndpoint &) = delete;
+
+    AsyncUdpEndpoint(AsyncUdpEndpoint &&) = delete;
+    AsyncUdpEndpoint &operator=(AsyncUdpEndpoint &&) = delete;
+
+    void SetMessageCallback(UdpMessageCallback cb) noexcept {
+        m_msg_callback = std::move(cb);
+    }
+
+    /// Datagrams rejected by the kernel are skipped so that the rest of the
+    /// queue could still be sent. Set this callback to find out about them.
+    /// The endpoint must not be destroyed in the callback.
+    void SetSendErrorCallback(UdpSendErrorCallback cb) noexcept {
+        m_send_error_callback = std::move(cb);
+    }
+
+    /// Receive at most @p batch_size datagrams per read event. Datagrams
+    /// larger than @p max_size are dropped.
+    void SetReceiveLimits(size_t batch_size, size_t max_size) noexcept {
+        m_batch_size        = (batch_size == 0) ? 1 : batch_size;
+        m_max_datagram_size = max_size;
+    }
+
+    void SetMaxSendQueueBytes(size_t bytes) noexcept {
+        m_max_send_queue_bytes = bytes;
+    }
+
+    /// Let the kernel coalesce received datagrams. This raises the datagram
+    /// size limit to MAX_COALESCED_SIZE, so each loop needs
+    /// batch size * 64KiB bytes of scratch space. Returns false if not
+    /// supported.
+    bool EnableReceiveOffload() noexcept;
+
+    /// Queue a datagram to @p peer. Could be called in any thread.
+    void AsyncSendTo(const void *data, size_t size, const InetAddr &peer);
+
+    /// Take ownership of @p data. No bytes are copied before reaching the
+    /// loop thread.
+    void AsyncSendTo(std::string &&data, const InetAddr &peer);
+
+    /// Send @p data as datagrams of @p segment_size bytes to @p peer. The
+    /// last one could be shorter. The kernel splits the buffer if it supports
+    /// UDP_SEGMENT, otherwise the segments are queued one by one. Could be
+    /// called in any thread.
+    void AsyncSendSegments(const void     *data,
+                           size_t          size,
+                           size_t          segment_size,
+                           const InetAddr &peer);
+
+    /// Take ownership of @p data.
+    void AsyncSendSegments(std::string   &&data,
+                           size_t          segment_size,
+                           const InetAddr &peer);
+
+    bool GetLocalAddr(InetAddr &addr) const noexcept {
+        return m_socket.GetLocalAddr(addr);
+    }
+
+    EventLoop       &GetLoop() const noexcept { return *m_loop; }
+    const UdpSocket &GetSocket() const noexcept { return m_socket; }
+
+    /// Bytes waiting in the send queue. Only call this method in loop thread.
+    size_t GetSendQueueBytes() const noexcept { return m_send_queue_bytes; }
+
+    /// Only call this method in loop thread.
+    const UdpEndpointStats &GetStats() const noexcept { return m_stats; }
+
+private:
+    struct PendingDatagram {
+        size_t   offset;
+        size_t   size;
+        size_t   segment_size; // 0 if not offloaded.
+        InetAddr peer;
+    };
+
+    void HandleRead();
+    void SendSegmentsInLoop(const void     *data,
+                            size_t          size,
+                            size_t          segment_size,
+                            const InetAddr &peer);
+    void Enqueue(const void     *data,
+                 size_t          size,
+                 size_t          segment_size,
+                 const InetAddr &peer);
+    void Flush();
+    void CompactSendQueue();
+
+private:
+    EventLoop           *m_loop;
+    UdpSocket            m_socket;
+    Listener             m_listener;
+    UdpMessageCallback   m_msg_callback;
+    UdpSendErrorCallback m_send_error_callback;
+
+    size_t m_batch_size;
+    size_t m_max_datagram_size;
+    size_t m_max_send_queue_bytes;
+    bool   m_receive_offload;
+
+    std::vector<char>            m_send_data;
+    std::vector<PendingDatagram> m_send_queue;
+    size_t                       m_send_head;
+    size_t                       m_send_queue_bytes;
+    bool                         m_flush_pending;
+
+    UdpEndpointStats m_stats;
+};
+
+} // namespace eveio
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace eveio {
+
+struct BufferPoolStats {
+    /// Bytes currently attached to connection read buffers.
+    size_t read_buffer_bytes = 0;
+    /// Bytes currently attached to connection write buffers.
+    size_t write_buffer_bytes = 0;
+    /// Bytes kept in free lists for reuse.
+    size_t cached_bytes = 0;
+    /// Highest value of read_buffer_bytes + write_buffer_bytes so far.
+    size_t peak_buffer_bytes = 0;
+    /// Number of blocks handed out by this pool.
+    uint64_t num_acquired = 0;
+    /// Number of blocks that had to be allocated from the system.
+    uint64_t num_system_alloc = 0;
+};
+
+/// Per-loop slab pool for connection buffers.
+///
+/// Blocks are grouped into power-of-two size classes. Released blocks are
+/// kept in per-class free lists until the cache limit is reached. Blocks larger
+/// than the biggest size class are allocated from and returned to the system
+/// directly.
+///
+/// BufferPool is NOT thread safe. Each EventLoop owns one pool and it must
+/// only be used in the loop thread.
+class BufferPool {
+public:
+    enum Category {
+        CATEGORY_READ  = 0,
+        CATEGORY_WRITE = 1,
+    };
+
+    static constexpr const size_t MIN_BLOCK_SIZE = 4096;
+    static constexpr const size_t MAX_BLOCK_SIZE = 1024 * 1024;
+    static constexpr const size_t NUM_CLASSES    = 9;
+
+    static constexpr const size_t DEFAULT_CACHE_LIMIT = 16 * 1024 * 1024;
+
+    BufferPool() noexcept = default;
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    BufferPool(BufferPool &&) = delete;
+    BufferPool &operator=(BufferPool &&) = delete;
+
+    /// Get a block of at least @p size bytes. The real size of the block is
+    /// written to @p capacity. Returns nullptr if failed to allocate memory.
+    char *Acquire(size_t size, Category category, size_t &capacity) noexcept;
+
+    /// Give back a block acquired from this pool.
+    void Release(char *block, size_t capacity, Category category) noexcept;
+
+    /// Limit the bytes kept in free lists. Extra blocks are freed immediately.
+    /// Use SetProcessLimit() to bound blocks attached to live buffers.
+    void SetCacheLimit(size_t bytes) noexcept;
+    size_t GetCacheLimit() const noexcept { return m_cache_limit; }
+
+    /// Free all cached blocks.
+    void Trim() noexcept;
+
+    const BufferPoolStats &GetStats() const noexcept { return m_stats; }
+
+    /// Bytes allocated from the system by all buffer pools in this process,
+    /// including cached blocks.
+    static size_t GetProcessBytes() noexcept {
+        return s_process_bytes.load(std::memory_order_relaxed);
+    }
+
+    /// Limit GetProcessBytes() of this process. 0 means unlimited and is the
+    /// default. Could be called from any thread.
+    ///
+    /// Connections stop reading while the process is at or above the limit
+    /// and resume once memory is released, and released blocks are not cached
+    /// meanwhile. Acquire() never fails because of the limit, since data that
+    /// is already received or queued could not be dropped, so the limit could
+    /// be exceeded by the data in flight. It should also leave room for the
+    /// largest incomplete message of every connection, which could not be
+    /// consumed before more data is read.
+    static void SetProcessLimit(size_t bytes) noexcept {
+        s_process_limit.store(bytes, std::memory_order_relaxed);
+    }
+
+    static size_t GetProcessLimit() noexcept {
+        return s_process_limit.load(std::memory_order_relaxed);
+    }
+
+    static bool IsAboveProcessLimit() noexcept {
+        size_t limit = GetProcessLimit();
+        return limit != 0 && GetProcessBytes() >= limit;
+    }
+
+private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    static size_t ClassIndex(size_t size) noexcept;
+    static size_t ClassSize(size_t index) noexcept {
+        return (MIN_BLOCK_SIZE << index);
+    }
+
+    void Account(Category category, size_t size, bool acquire) noexcept;
+    void FreeCached(size_t index) noexcept;
+
+private:
+    FreeBlock      *m_free_list[NUM_CLASSES]{};
+    size_t          m_cache_limit = DEFAULT_CACHE_LIMIT;
+    BufferPoolStats m_stats;
+
+    static std::atomic_size_t s_process_bytes;
+    static std::atomic_size_t s_process_limit;
+};
+
+} // namespace eveio
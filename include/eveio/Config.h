@@ -41,5 +41,34 @@
 #    include <sys/socket.h>
 #    include <sys/stat.h>
 #    include <sys/types.h>
+#    include <sys/uio.h>
 #    include <unistd.h>
+#    if EVEIO_OS_LINUX
+#        include <linux/errqueue.h>
+#        include <netinet/udp.h>
+#        include <sys/eventfd.h>
+#        include <sys/mman.h>
+#        include <sys/sendfile.h>
+#    endif
+#endif
+
+#if EVEIO_OS_LINUX && defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) &&         \
+    defined(SO_EE_ORIGIN_ZEROCOPY)
+#    define EVEIO_HAS_ZEROCOPY 1
+#endif
+
+#if EVEIO_OS_LINUX || EVEIO_OS_FREEBSD
+#    define EVEIO_HAS_MMSG 1
+#endif
+
+#if EVEIO_OS_LINUX && defined(UDP_SEGMENT)
+#    define EVEIO_HAS_UDP_GSO 1
+#endif
+
+#if EVEIO_OS_LINUX && defined(UDP_GRO)
+#    define EVEIO_HAS_UDP_GRO 1
+#endif
+
+#if EVEIO_OS_LINUX && defined(MFD_CLOEXEC)
+#    define EVEIO_HAS_SHM_RING 1
 #endif
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "eveio/Config.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+
+/// Build with -DEVEIO_ENABLE_CONN_STATS=ON to count I/O of every connection
+/// and to call trace hooks. Otherwise all of it compiles to nothing.
+#ifndef EVEIO_ENABLE_CONN_STATS
+#    define EVEIO_ENABLE_CONN_STATS 0
+#endif
+
+namespace eveio {
+
+class AsyncTcpConnection;
+
+struct TcpConnectionStats {
+    uint64_t bytes_read    = 0;
+    uint64_t bytes_written = 0;
+    /// Number of recv system calls.
+    uint64_t num_recv_calls = 0;
+    /// Number of send, writev, sendfile and zero copy system calls.
+    uint64_t num_send_calls = 0;
+    /// Number of recv calls that found no data.
+    uint64_t num_recv_eagain = 0;
+    /// Number of send calls that found the socket buffer full.
+    uint64_t num_send_eagain = 0;
+    /// Number of message callback invocations.
+    uint64_t num_msg_callbacks = 0;
+    /// Time spent in the message callback.
+    uint64_t msg_callback_ns = 0;
+};
+
+/// Hooks to feed an external tracer. Every hook is optional and called in
+/// the loop thread of the connection with @p context as the first argument.
+struct TcpTraceHooks {
+    using Hook = void (*)(void *context, const AsyncTcpConnection *conn);
+
+    void *context = nullptr;
+
+    /// TcpServer has set up a new connection, right before the connection
+    /// callback.
+    Hook on_accept = nullptr;
+    /// The first bytes of a connection are read.
+    Hook on_first_byte = nullptr;
+    /// Around each message callback.
+    Hook on_callback_enter = nullptr;
+    Hook on_callback_exit  = nullptr;
+    /// The connection is about to be deleted, before the close callback.
+    Hook on_destroy = nullptr;
+};
+
+/// Install @p hooks for all connections, or remove them with nullptr.
+/// @p hooks must stay alive until it is replaced. Has no effect unless built
+/// with EVEIO_ENABLE_CONN_STATS.
+void SetTcpTraceHooks(const TcpTraceHooks *hooks) noexcept;
+
+/// For internal usage.
+const TcpTraceHooks *GetTcpTraceHooks() noexcept;
+
+/// For internal usage. Records stats of one connection. AsyncTcpConnection
+/// holds TcpConnStatsRecorder, which selects one of the specializations at
+/// compile time.
+template <bool Enabled>
+class TcpConnStatsPolicy;
+
+/// Everything is a no-op and the object is empty.
+template <>
+class TcpConnStatsPolicy<false> {
+public:
+    struct CallbackScope {};
+
+    static void TraceAccept(const AsyncTcpConnection *) noexcept {}
+
+    void OnReceive(const AsyncTcpConnection *, int64_t) noexcept {}
+    void OnSend(int64_t) noexcept {}
+    void OnDestroy(const AsyncTcpConnection *) noexcept {}
+
+    CallbackScope EnterCallback(const AsyncTcpConnection *) noexcept {
+        return CallbackScope();
+    }
+
+    void LeaveCallback(const AsyncTcpConnection *, CallbackScope) noexcept {}
+
+    TcpConnectionStats Get() const noexcept { return TcpConnectionStats(); }
+};
+
+template <>
+class TcpConnStatsPolicy<true> {
+public:
+    struct CallbackScope {
+        std::chrono::steady_clock::time_point start;
+    };
+
+    static void TraceAccept(const AsyncTcpConnection *conn) noexcept {
+        const TcpTraceHooks *hooks = GetTcpTraceHooks();
+        if (hooks != nullptr && hooks->on_accept != nullptr)
+            hooks->on_accept(hooks->context, conn);
+    }
+
+    /// @p ret is the return value of the recv call.
+    void OnReceive(const AsyncTcpConnection *conn, int64_t ret) noexcept {
+        ++m_stats.num_recv_calls;
+        if (ret > 0) {
+            if (m_stats.bytes_read == 0) {
+                const TcpTraceHooks *hooks = GetTcpTraceHooks();
+                if (hooks != nullptr && hooks->on_first_byte != nullptr)
+                    hooks->on_first_byte(hooks->context, conn);
+            }
+            m_stats.bytes_read += static_cast<uint64_t>(ret);
+        } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ++m_stats.num_recv_eagain;
+        }
+    }
+
+    /// @p ret is the return value of the send call.
+    void OnSend(int64_t ret) noexcept {
+        ++m_stats.num_send_calls;
+        if (ret > 0) {
+            m_stats.bytes_written += static_cast<uint64_t>(ret);
+        } else if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ++m_stats.num_send_eagain;
+        }
+    }
+
+    void OnDestroy(const AsyncTcpConnection *conn) noexcept {
+        const TcpTraceHooks *hooks = GetTcpTraceHooks();
+        if (hooks != nullptr && hooks->on_destroy != nullptr)
+            hooks->on_destroy(hooks->context, conn);
+    }
+
+    CallbackScope EnterCallback(const AsyncTcpConnection *conn) noexcept {
+        const TcpTraceHooks *hooks = GetTcpTraceHooks();
+        if (hooks != nullptr && hooks->on_callback_enter != nullptr)
+            hooks->on_callback_enter(hooks->context, conn);
+        return CallbackScope{std::chrono::steady_clock::now()};
+    }
+
+    void LeaveCallback(const AsyncTcpConnection *conn,
+                       CallbackScope             scope) noexcept {
+        auto elapsed = std::chrono::steady_clock::now() - scope.start;
+        ++m_stats.num_msg_callbacks;
+        m_stats.msg_callback_ns += static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                .count());
+
+        const TcpTraceHooks *hooks = GetTcpTraceHooks();
+        if (hooks != nullptr && hooks->on_callback_exit != nullptr)
+            hooks->on_callback_exit(hooks->context, conn);
+    }
+
+    TcpConnectionStats Get() const noexcept { return m_stats; }
+
+private:
+    TcpConnectionStats m_stats;
+};
+
+using TcpConnStatsRecorder = TcpConnStatsPolicy<EVEIO_ENABLE_CONN_STATS != 0>;
+
+} // namespace eveio
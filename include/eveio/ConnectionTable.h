@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace eveio {
+
+class AsyncTcpConnection;
+
+/// Per-loop table of live connections, addressed by slot and generation.
+///
+/// Freed slots are reused, and each reuse bumps the generation of the slot, so
+/// a stale (slot, generation) pair never resolves to a newer connection.
+///
+/// ConnectionTable is NOT thread safe. Each EventLoop owns one table and it
+/// must only be used in the loop thread.
+class ConnectionTable {
+public:
+    static constexpr const uint32_t SLOT_BITS       = 24;
+    static constexpr const uint32_t GENERATION_BITS = 28;
+
+    static constexpr const uint32_t MAX_SLOTS       = (1U << SLOT_BITS) - 1;
+    static constexpr const uint32_t GENERATION_MASK =
+        (1U << GENERATION_BITS) - 1;
+    static constexpr const uint32_t INVALID_SLOT = UINT32_MAX;
+
+    ConnectionTable() noexcept = default;
+
+    ConnectionTable(const ConnectionTable &) = delete;
+    ConnectionTable &operator=(const ConnectionTable &) = delete;
+
+    ConnectionTable(ConnectionTable &&) = delete;
+    ConnectionTable &operator=(ConnectionTable &&) = delete;
+
+    /// Returns slot of @p conn and writes its generation to @p generation.
+    /// Returns INVALID_SLOT if the table is full.
+    uint32_t Insert(AsyncTcpConnection *conn, uint32_t &generation);
+
+    /// Free @p slot. The generation of the slot is bumped.
+    void Remove(uint32_t slot) noexcept;
+
+    /// Returns nullptr if the connection is gone.
+    AsyncTcpConnection *Find(uint32_t slot,
+                             uint32_t generation) const noexcept {
+        if (slot >= m_slots.size())
+            return nullptr;
+
+        const Slot &entry = m_slots[slot];
+        return (entry.generation == generation) ? entry.conn : nullptr;
+    }
+
+    size_t Size() const noexcept { return m_size; }
+
+private:
+    struct Slot {
+        AsyncTcpConnection *conn;
+        uint32_t            generation;
+        uint32_t            next_free;
+    };
+
+private:
+    std::vector<Slot> m_slots;
+    uint32_t          m_free_head = INVALID_SLOT;
+    size_t            m_size      = 0;
+};
+
+} // namespace eveio
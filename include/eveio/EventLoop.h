@@ -1,20 +1,44 @@
 #pragma once
 
+#include "eveio/BufferPool.h"
+#include "eveio/ConnectionTable.h"
+#include "eveio/ObjectPool.h"
 #include "eveio/Poller.h"
 #include "eveio/Thread.h"
 #include "eveio/WakeupHandle.h"
 
 #include <atomic>
+#include <chrono>
 #include <functional>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <unordered_map>
 
 namespace eveio {
 
 class Listener;
+struct UdpMessageBatch;
+
+/// Counters of an EventLoop. Only read or modify them in the loop thread.
+struct EventLoopStats {
+    /// Number of times a connection stopped reading because its read buffer
+    /// reached the maximum size.
+    uint64_t num_read_buffer_full = 0;
+    /// Number of times a connection stopped reading because the process
+    /// reached BufferPool process limit.
+    uint64_t num_read_memory_limit = 0;
+};
 
 class EventLoop {
 public:
+    using TimerId = uint64_t;
+
+    /// Maximum number of event loops alive at the same time that could be
+    /// found by index.
+    static constexpr const uint32_t MAX_LOOPS     = 4096;
+    static constexpr const uint32_t INVALID_INDEX = UINT32_MAX;
+
     EventLoop();
     ~EventLoop();
 
@@ -45,6 +69,35 @@ public:
 
     thread_id_t GetLoopThreadId() const noexcept { return m_thread_id; }
 
+    /// Process-wide index of this loop, or INVALID_INDEX if more than
+    /// MAX_LOOPS loops are alive. Indices of destroyed loops are reused.
+    uint32_t GetIndex() const noexcept { return m_index; }
+
+    /// Find a live loop by its index. Returns nullptr if there is none. The
+    /// caller must make sure that the loop is not destroyed meanwhile.
+    static EventLoop *FromIndex(uint32_t index) noexcept;
+
+    /// Buffer pool of this loop. Only use it in the loop thread.
+    BufferPool &GetBufferPool() noexcept { return m_buffer_pool; }
+
+    /// Free list of connection objects of this loop. Only use it in the loop
+    /// thread.
+    ObjectPool &GetConnectionPool() noexcept { return m_connection_pool; }
+
+    /// Connections of this loop addressed by TcpConnectionHandle. Only use it
+    /// in the loop thread.
+    ConnectionTable &GetConnectionTable() noexcept {
+        return m_connection_table;
+    }
+
+    /// For internal usage. Scratch space shared by UDP endpoints of this loop.
+    /// Only use it in the loop thread.
+    UdpMessageBatch &GetUdpBatch();
+
+    /// Statistics of this loop. Only use it in the loop thread.
+    EventLoopStats       &GetStats() noexcept { return m_stats; }
+    const EventLoopStats &GetStats() const noexcept { return m_stats; }
+
     template <typename Fn>
     void RunInLoop(Fn &&fn) {
         if (IsInLoopThread()) {
@@ -64,6 +117,38 @@ public:
         m_pending_func.push_back(std::move(fn));
     }
 
+    /// Milliseconds of a monotonic clock, sampled once per loop iteration
+    /// after polling. Cheap enough to stamp every read and write. Only call
+    /// this method in loop thread.
+    int64_t GetCoarseTime() const noexcept { return m_coarse_time; }
+
+    /// Call @p fn in loop thread once after @p delay. Could be called from any
+    /// thread. Timers are checked once per loop iteration, so they are
+    /// accurate to a few milliseconds at best.
+    TimerId RunAfter(std::chrono::milliseconds delay, std::function<void()> fn);
+
+    /// Call @p fn in loop thread every @p interval. Could be called from any
+    /// thread.
+    TimerId RunEvery(std::chrono::milliseconds interval,
+                     std::function<void()>     fn);
+
+    /// Cancel a timer. It is safe to cancel a timer inside its own callback or
+    /// a timer that has already fired. Could be called from any thread.
+    void CancelTimer(TimerId id);
+
+    using DeferredCallback = auto (*)(void *) -> void;
+
+    /// For internal usage. Call @p fn with @p object once the current batch of
+    /// events or pending functions is handled. Only call this method in loop
+    /// thread.
+    void QueueAfterEvents(DeferredCallback fn, void *object) {
+        m_deferred.emplace_back(fn, object);
+    }
+
+    /// For internal usage. Remove calls queued for @p object. Only call this
+    /// method in loop thread.
+    void CancelAfterEvents(void *object) noexcept;
+
     /// For internal usage. Do not call this method manually.
     void UpdateListener(Listener &listener) {
         m_poller.UpdateListener(listener);
@@ -74,18 +159,56 @@ public:
         m_poller.UnregistListener(listener);
     }
 
+private:
+    struct Timer {
+        int64_t               interval;
+        std::function<void()> callback;
+    };
+
+    void RunDeferred() noexcept;
+
+    static int64_t Now() noexcept;
+
+    static uint32_t AllocateIndex(EventLoop *loop) noexcept;
+
+    TimerId AddTimer(int64_t                delay,
+                     int64_t                interval,
+                     std::function<void()> &&fn);
+    void    ScheduleTimer(TimerId id, int64_t due, Timer &&timer);
+    void    RunTimers();
+
+    std::chrono::milliseconds GetPollTimeout() const noexcept;
+
 private:
     Poller           m_poller;
     std::atomic_bool m_is_looping;
     std::atomic_bool m_is_quit;
 
     const thread_id_t m_thread_id;
+    const uint32_t    m_index;
 
     WakeupHandle              m_wakeup_handle;
     std::unique_ptr<Listener> m_wakeup_listener;
 
     std::vector<std::function<void()>> m_pending_func;
     mutable std::mutex                 m_pending_func_mutex;
+
+    std::vector<std::pair<DeferredCallback, void *>> m_deferred;
+    std::vector<std::pair<DeferredCallback, void *>> m_running_deferred;
+
+    int64_t m_coarse_time;
+
+    /// Timers ordered by due time. Only accessed in loop thread.
+    std::map<std::pair<int64_t, TimerId>, Timer> m_timers;
+    std::unordered_map<TimerId, int64_t>         m_timer_due;
+    std::atomic<TimerId>                         m_next_timer_id;
+
+    BufferPool      m_buffer_pool;
+    ObjectPool      m_connection_pool;
+    ConnectionTable m_connection_table;
+    EventLoopStats  m_stats;
+
+    std::unique_ptr<UdpMessageBatch> m_udp_batch;
 };
 
 } // namespace eveio
@@ -25,7 +25,14 @@ public:
     EventLoopThreadPool &operator=(EventLoopThreadPool &&) = delete;
 
     EventLoop      *GetNextLoop() noexcept;
-    const LoopList &GetAllLoops() const noexcept;
+    const LoopList &GetAllLoops() const noexcept { return m_loops; }
+
+    /// Round robin like GetNextLoop(), but returns index of the loop in
+    /// GetAllLoops(). Only call this method after Start().
+    size_t GetNextLoopIndex() noexcept {
+        return m_next_loop.fetch_add(1, std::memory_order_relaxed) %
+               m_loops.size();
+    }
 
     void SetThreadNum(size_t num) noexcept {
         m_num_threads.store(num, std::memory_order_relaxed);
@@ -0,0 +1,218 @@
+#pragma once
+
+#include "eveio/AsyncTcpConnection.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+namespace eveio {
+
+enum class ByteOrder {
+    BigEndian,
+    LittleEndian,
+};
+
+/// Fixed size length prefix. @p T must be an unsigned integer type.
+template <typename T, ByteOrder Order = ByteOrder::BigEndian>
+struct FixedLengthField {
+    static_assert(std::is_unsigned<T>::value,
+                  "Length field must be an unsigned integer type.");
+
+    static constexpr const size_t MAX_HEADER_SIZE = sizeof(T);
+
+    static uint64_t MaxLength() noexcept {
+        return static_cast<uint64_t>(std::numeric_limits<T>::max());
+    }
+
+    /// Returns size of the header, 0 if the header is incomplete or -1 if the
+    /// header is malformed.
+    static int Decode(const char *data, size_t size,
+                      uint64_t &length) noexcept {
+        if (size < sizeof(T))
+            return 0;
+
+        auto     p     = reinterpret_cast<const unsigned char *>(data);
+        uint64_t value = 0;
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            size_t index = (Order == ByteOrder::BigEndian) ? i
+                                                           : sizeof(T) - 1 - i;
+            value        = (value << 8) | p[index];
+        }
+
+        length = value;
+        return static_cast<int>(sizeof(T));
+    }
+
+    /// Write header to @p out. Returns size of the header.
+    static size_t Encode(uint64_t length, char *out) noexcept {
+        auto p = reinterpret_cast<unsigned char *>(out);
+        for (size_t i = 0; i < sizeof(T); ++i) {
+            size_t index = (Order == ByteOrder::BigEndian) ? sizeof(T) - 1 - i
+                                                           : i;
+            p[index]     = static_cast<unsigned char>(length & 0xFF);
+            length >>= 8;
+        }
+        return sizeof(T);
+    }
+};
+
+/// LEB128 encoded length prefix, as used by protobuf.
+struct VarintLengthField {
+    static constexpr const size_t MAX_HEADER_SIZE = 10;
+
+    static uint64_t MaxLength() noexcept {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    static int Decode(const char *data, size_t size,
+                      uint64_t &length) noexcept {
+        auto     p     = reinterpret_cast<const unsigned char *>(data);
+        uint64_t value = 0;
+        for (size_t i = 0; i < MAX_HEADER_SIZE; ++i) {
+            if (i >= size)
+                return 0;
+
+            value |= static_cast<uint64_t>(p[i] & 0x7F) << (7 * i);
+            if ((p[i] & 0x80) == 0) {
+                length = value;
+                return static_cast<int>(i + 1);
+            }
+        }
+        return -1;
+    }
+
+    static size_t Encode(uint64_t length, char *out) noexcept {
+        auto   p    = reinterpret_cast<unsigned char *>(out);
+        size_t size = 0;
+        while (length >= 0x80) {
+            p[size++] = static_cast<unsigned char>(length | 0x80);
+            length >>= 7;
+        }
+        p[size++] = static_cast<unsigned char>(length);
+        return size;
+    }
+};
+
+/// A complete frame without its length prefix. It points into the read buffer
+/// of the connection and is only valid during the frame callback.
+struct FrameView {
+    const char *data;
+    size_t      size;
+};
+
+using TcpFrameCallback = std::function<void(
+    AsyncTcpConnection *, const FrameView *frames, size_t count)>;
+
+/// Length prefixed framing on top of AsyncTcpConnection.
+///
+/// Every complete frame received by one read event is delivered with one call
+/// to the frame callback, as views into the read buffer. The frames are
+/// consumed once the callback returns. A connection sending a malformed or
+/// oversized frame is destroyed.
+///
+/// Example:
+///   FrameCodec<FixedLengthField<uint32_t>> codec(on_frames);
+///   server.SetMessageCallback(codec.GetMessageCallback());
+///
+/// The codec must outlive the connections using it.
+template <typename LengthField>
+class FrameCodec {
+public:
+    static constexpr const size_t DEFAULT_MAX_FRAME_SIZE = 64 * 1024 * 1024;
+
+    explicit FrameCodec(TcpFrameCallback cb,
+                        size_t max_frame_size = DEFAULT_MAX_FRAME_SIZE)
+        : m_frame_callback(std::move(cb)),
+          m_max_frame_size(std::min<uint64_t>(max_frame_size,
+                                              LengthField::MaxLength())) {}
+
+    FrameCodec(const FrameCodec &) = delete;
+    FrameCodec &operator=(const FrameCodec &) = delete;
+
+    FrameCodec(FrameCodec &&) = delete;
+    FrameCodec &operator=(FrameCodec &&) = delete;
+
+    TcpMessageCallback GetMessageCallback() {
+        return [this](AsyncTcpConnection *conn, AsyncTcpConnBuffer &buffer) {
+            this->OnMessage(conn, buffer);
+        };
+    }
+
+    void OnMessage(AsyncTcpConnection *conn, AsyncTcpConnBuffer &buffer) {
+        // Scratch list is per thread since one codec serves many loops.
+        static thread_local std::vector<FrameView> frames;
+        frames.clear();
+
+        const char *data     = buffer.Data<char>();
+        size_t      size     = buffer.Size();
+        size_t      consumed = 0;
+        uint64_t    length   = 0;
+
+        while (consumed < size) {
+            int header = LengthField::Decode(
+                data + consumed, size - consumed, length);
+            if (header < 0 || length > m_max_frame_size) {
+                buffer.Clear();
+                conn->Destroy();
+                return;
+            }
+
+            if (header == 0 ||
+                size - consumed - static_cast<size_t>(header) < length) {
+                break;
+            }
+
+            const char *frame = data + consumed + header;
+            frames.push_back(FrameView{frame, static_cast<size_t>(length)});
+            consumed += static_cast<size_t>(header) + length;
+        }
+
+        if (!frames.empty() && m_frame_callback)
+            m_frame_callback(conn, frames.data(), frames.size());
+
+        buffer.ReadOut(consumed);
+
+        // Make room for the pending frame. The length prefix comes from the
+        // peer, so reserve at most one pool block and let the buffer grow as
+        // the payload actually arrives.
+        if (!buffer.IsEmpty() && consumed < size) {
+            int header = LengthField::Decode(
+                buffer.Data<char>(), buffer.Size(), length);
+            if (header > 0) {
+                size_t remaining = static_cast<size_t>(header) + length -
+                                   buffer.Size();
+                buffer.Reserve(
+                    std::min(remaining, BufferPool::MAX_BLOCK_SIZE));
+            }
+        }
+    }
+
+    /// Send @p data as one frame. Header and payload are gathered into one
+    /// send without building a temporary frame.
+    ///
+    /// Returns false and sends nothing if @p size exceeds the max frame size,
+    /// the same limit OnMessage enforces on received frames.
+    bool Send(AsyncTcpConnection *conn, const void *data, size_t size) const {
+        if (static_cast<uint64_t>(size) > m_max_frame_size)
+            return false;
+
+        char         header[LengthField::MAX_HEADER_SIZE];
+        struct iovec vec[2];
+        vec[0].iov_base = header;
+        vec[0].iov_len  = LengthField::Encode(size, header);
+        vec[1].iov_base = const_cast<void *>(data);
+        vec[1].iov_len  = size;
+        conn->AsyncSend(vec, 2);
+        return true;
+    }
+
+private:
+    TcpFrameCallback m_frame_callback;
+    uint64_t         m_max_frame_size;
+};
+
+} // namespace eveio
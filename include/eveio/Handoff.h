@@ -0,0 +1,100 @@
+#pragma once
+
+#include "eveio/TcpSocket.h"
+
+#include <mutex>
+#include <string>
+
+namespace eveio {
+
+/// A socket passed from an old process to a new one.
+struct HandoffItem {
+    enum Kind {
+        KIND_LISTENER   = 1,
+        KIND_CONNECTION = 2,
+    };
+
+    Kind kind = KIND_LISTENER;
+
+    /// Now owned by the receiver. Wrap it in TcpSocket or TcpConnection.
+    socket_t sock = INVALID_SOCKET;
+
+    /// Name given by the sender, e.g. to tell listeners of different servers
+    /// apart.
+    std::string name;
+
+    /// Bytes a connection has received but the old process has not
+    /// consumed.
+    std::string data;
+};
+
+/// Old process side of a hot restart.
+///
+/// Sockets are passed with SCM_RIGHTS over a connected AF_UNIX stream socket,
+/// so the new process could keep accepting on the same listening sockets and
+/// keep serving established connections without any reconnect. A typical
+/// setup lets the old process accept on a well-known UnixAddr: a new process
+/// that manages to connect there takes over with HandoffReceiver, otherwise
+/// it starts cold. See TcpServer::HandOffListener() and
+/// TcpServer::HandOffIdleConnections().
+///
+/// The socket is used in blocking mode. Methods could be called from several
+/// threads at once.
+class HandoffSender {
+public:
+    explicit HandoffSender(TcpConnection &&conn) noexcept;
+
+    HandoffSender(const HandoffSender &) = delete;
+    HandoffSender &operator=(const HandoffSender &) = delete;
+
+    bool IsValid() const noexcept { return m_conn.IsValid(); }
+
+    /// Send a listening socket. The caller keeps its own copy of @p sock.
+    bool SendListener(const std::string &name, socket_t sock) noexcept;
+
+    /// Send a connection and its unconsumed input. The caller keeps its own
+    /// copy of @p sock.
+    bool SendConnection(const std::string &name,
+                        socket_t           sock,
+                        const std::string &buffered) noexcept;
+
+    /// Tell the receiver that nothing follows and wait until it has taken all
+    /// sockets.
+    bool Finish() noexcept;
+
+private:
+    bool Send(HandoffItem::Kind  kind,
+              const std::string &name,
+              socket_t           sock,
+              const std::string &data) noexcept;
+
+private:
+    TcpConnection m_conn;
+    std::mutex    m_mutex;
+};
+
+/// New process side of a hot restart. See HandoffSender.
+class HandoffReceiver {
+public:
+    explicit HandoffReceiver(TcpConnection &&conn) noexcept;
+
+    HandoffReceiver(const HandoffReceiver &) = delete;
+    HandoffReceiver &operator=(const HandoffReceiver &) = delete;
+
+    bool IsValid() const noexcept { return m_conn.IsValid(); }
+
+    /// Wait for the next socket. Returns false once the sender has finished,
+    /// or on error. Use IsFinished() to tell them apart.
+    bool Receive(HandoffItem &item) noexcept;
+
+    bool IsFinished() const noexcept { return m_is_finished; }
+
+private:
+    bool ReadFully(void *buffer, size_t size, int &fd) noexcept;
+
+private:
+    TcpConnection m_conn;
+    bool          m_is_finished;
+};
+
+} // namespace eveio
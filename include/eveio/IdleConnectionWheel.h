@@ -0,0 +1,78 @@
+#pragma once
+
+#include "eveio/EventLoop.h"
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace eveio {
+
+class AsyncTcpConnection;
+
+/// Bucketed timing wheel that destroys connections idle for too long.
+///
+/// Connections only stamp EventLoop::GetCoarseTime() on reads and writes. The
+/// wheel never moves a connection on activity. Instead each tick checks the
+/// bucket that is due: expired connections are destroyed in a batch and the
+/// others are moved to the bucket of their new deadline. Every connection is
+/// checked about once per timeout, no matter how many messages it handles.
+///
+/// IdleConnectionWheel is NOT thread safe. It must be created, used and
+/// destroyed in the loop thread, and its owner must call Sweep() every
+/// GetTickInterval().
+class IdleConnectionWheel {
+public:
+    static constexpr const size_t DEFAULT_NUM_BUCKETS = 8;
+
+    static constexpr const uint32_t INVALID_BUCKET = UINT32_MAX;
+
+    IdleConnectionWheel(EventLoop                &loop,
+                        std::chrono::milliseconds timeout,
+                        size_t num_buckets = DEFAULT_NUM_BUCKETS);
+
+    IdleConnectionWheel(const IdleConnectionWheel &) = delete;
+    IdleConnectionWheel &operator=(const IdleConnectionWheel &) = delete;
+
+    IdleConnectionWheel(IdleConnectionWheel &&) = delete;
+    IdleConnectionWheel &operator=(IdleConnectionWheel &&) = delete;
+
+    /// Start tracking @p conn. Its last active time is reset to now.
+    void Add(AsyncTcpConnection *conn);
+
+    /// Stop tracking @p conn. Does nothing if @p conn is not tracked.
+    void Remove(AsyncTcpConnection *conn) noexcept;
+
+    /// Destroy connections whose idle time reached the timeout.
+    void Sweep();
+
+    std::chrono::milliseconds GetTickInterval() const noexcept {
+        return std::chrono::milliseconds(m_tick);
+    }
+
+    size_t Size() const noexcept { return m_size; }
+
+    /// Total number of connections destroyed by this wheel.
+    uint64_t GetExpiredCount() const noexcept { return m_num_expired; }
+
+private:
+    void Insert(AsyncTcpConnection *conn, size_t bucket);
+
+    size_t SlotOf(int64_t time) const noexcept {
+        return static_cast<size_t>(time / m_tick);
+    }
+
+private:
+    EventLoop *const m_loop;
+    int64_t          m_timeout;
+    int64_t          m_tick;
+    size_t           m_last_slot;
+    size_t           m_size;
+    uint64_t         m_num_expired;
+
+    std::vector<std::vector<AsyncTcpConnection *>> m_buckets;
+    std::vector<AsyncTcpConnection *>              m_sweeping;
+    std::vector<AsyncTcpConnection *>              m_expired;
+};
+
+} // namespace eveio
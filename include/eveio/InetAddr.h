@@ -2,6 +2,7 @@
 
 #include "eveio/Config.h"
 
+#include <functional>
 #include <string>
 
 namespace eveio {
@@ -49,6 +50,9 @@ public:
         return !(*this == rhs);
     }
 
+    /// Hash value consistent with operator==.
+    size_t Hash() const noexcept;
+
     static InetAddr Ipv4Loopback(uint16_t port) noexcept;
     static InetAddr Ipv4Any(uint16_t port) noexcept;
     static InetAddr Ipv6Loopback(uint16_t port) noexcept;
@@ -62,3 +66,14 @@ private:
 };
 
 } // namespace eveio
+
+namespace std {
+
+template <>
+struct hash<eveio::InetAddr> {
+    size_t operator()(const eveio::InetAddr &addr) const noexcept {
+        return addr.Hash();
+    }
+};
+
+} // namespace std
@@ -11,6 +11,8 @@ enum {
     EVENT_NONE  = 0x00,
     EVENT_READ  = 0x01,
     EVENT_WRITE = 0x02,
+    /// Reported by poller only. Cannot be listened explicitly.
+    EVENT_ERROR = 0x04,
 };
 
 class EventLoop;
@@ -33,9 +35,11 @@ public:
 
     void SetReadCallback(Callback cb) noexcept { m_read_callback = cb; }
     void SetWriteCallback(Callback cb) noexcept { m_write_callback = cb; }
+    void SetErrorCallback(Callback cb) noexcept { m_error_callback = cb; }
 
     Callback GetReadCallback() const noexcept { return m_read_callback; }
-    Callback GetWriteCallback() const noexcept { return m_read_callback; }
+    Callback GetWriteCallback() const noexcept { return m_write_callback; }
+    Callback GetErrorCallback() const noexcept { return m_error_callback; }
 
     EventLoop &GetLoop() const noexcept { return *m_loop; }
     int        GetFD() const noexcept { return m_fd; }
@@ -96,6 +100,7 @@ private:
     uint32_t m_events_listening = EVENT_NONE;
     Callback m_read_callback    = nullptr;
     Callback m_write_callback   = nullptr;
+    Callback m_error_callback   = nullptr;
 };
 
 } // namespace eveio
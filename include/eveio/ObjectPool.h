@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace eveio {
+
+struct ObjectPoolStats {
+    /// Number of objects kept in the free list.
+    size_t cached_objects = 0;
+    /// Number of objects handed out by this pool.
+    uint64_t num_acquired = 0;
+    /// Number of objects that had to be allocated from the system.
+    uint64_t num_system_alloc = 0;
+};
+
+/// Per-loop free list of fixed size objects.
+///
+/// The object size is fixed by the first Acquire() call. Requests of other
+/// sizes are served by the system allocator directly. Memory comes from
+/// ::operator new(), so an object allocated with plain new could also be
+/// released to this pool.
+///
+/// ObjectPool is NOT thread safe. Each EventLoop owns one pool for its
+/// connection objects and it must only be used in the loop thread.
+class ObjectPool {
+public:
+    static constexpr const size_t DEFAULT_CACHE_LIMIT = 4096;
+
+    ObjectPool() noexcept = default;
+    ~ObjectPool();
+
+    ObjectPool(const ObjectPool &) = delete;
+    ObjectPool &operator=(const ObjectPool &) = delete;
+
+    ObjectPool(ObjectPool &&) = delete;
+    ObjectPool &operator=(ObjectPool &&) = delete;
+
+    /// Get uninitialized memory for an object of @p size bytes.
+    void *Acquire(size_t size);
+
+    /// Give back memory of a destroyed object of @p size bytes.
+    void Release(void *object, size_t size) noexcept;
+
+    /// Limit the number of cached objects. Extra objects are freed
+    /// immediately. A limit of 0 disables recycling.
+    void   SetCacheLimit(size_t count) noexcept;
+    size_t GetCacheLimit() const noexcept { return m_cache_limit; }
+
+    /// Free all cached objects.
+    void Trim() noexcept { FreeCached(0); }
+
+    const ObjectPoolStats &GetStats() const noexcept { return m_stats; }
+
+private:
+    struct FreeObject {
+        FreeObject *next;
+    };
+
+    void FreeCached(size_t keep) noexcept;
+
+private:
+    FreeObject     *m_free_list   = nullptr;
+    size_t          m_object_size = 0;
+    size_t          m_cache_limit = DEFAULT_CACHE_LIMIT;
+    ObjectPoolStats m_stats;
+};
+
+} // namespace eveio
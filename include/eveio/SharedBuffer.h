@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace eveio {
+
+/// Reference counted immutable byte buffer.
+///
+/// Copying a SharedBuffer only touches the reference counter, so the same
+/// bytes could be queued on many connections and passed across threads without
+/// copying the payload. The content must not be modified once constructed.
+class SharedBuffer {
+public:
+    SharedBuffer() noexcept = default;
+
+    /// Copy @p size bytes from @p data into a new buffer.
+    SharedBuffer(const void *data, size_t size);
+
+    /// Take ownership of the string. No bytes are copied for heap-allocated
+    /// strings.
+    explicit SharedBuffer(std::string &&data);
+
+    /// Take ownership of the vector. No bytes are copied.
+    explicit SharedBuffer(std::vector<char> &&data);
+
+    SharedBuffer(const SharedBuffer &other) noexcept : m_block(other.m_block) {
+        Retain();
+    }
+
+    SharedBuffer &operator=(const SharedBuffer &other) noexcept {
+        if (m_block != other.m_block) {
+            Reset();
+            m_block = other.m_block;
+            Retain();
+        }
+        return (*this);
+    }
+
+    SharedBuffer(SharedBuffer &&other) noexcept : m_block(other.m_block) {
+        other.m_block = nullptr;
+    }
+
+    SharedBuffer &operator=(SharedBuffer &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            m_block       = other.m_block;
+            other.m_block = nullptr;
+        }
+        return (*this);
+    }
+
+    ~SharedBuffer() { Reset(); }
+
+    const char *Data() const noexcept {
+        return (m_block == nullptr) ? nullptr : m_block->data;
+    }
+
+    size_t Size() const noexcept {
+        return (m_block == nullptr) ? 0 : m_block->size;
+    }
+
+    bool IsNull() const noexcept { return m_block == nullptr; }
+    bool IsEmpty() const noexcept { return Size() == 0; }
+
+    size_t UseCount() const noexcept {
+        return (m_block == nullptr)
+                   ? 0
+                   : m_block->refcount.load(std::memory_order_relaxed);
+    }
+
+    void Reset() noexcept;
+
+private:
+    struct Block {
+        std::atomic_size_t refcount;
+        const char        *data;
+        size_t             size;
+        void (*destroy)(Block *);
+    };
+
+    template <typename T>
+    struct OwnedBlock;
+
+    void Retain() noexcept {
+        if (m_block != nullptr)
+            m_block->refcount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+private:
+    Block *m_block = nullptr;
+};
+
+} // namespace eveio
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "eveio/TcpSocket.h"
+
+#if EVEIO_HAS_SHM_RING
+
+#    include <atomic>
+
+namespace eveio {
+
+/// For internal usage. One direction of a ShmChannel. Lives in the shared
+/// segment. Positions only grow; they are taken modulo the ring size.
+struct ShmRingControl {
+    /// Written by the producer.
+    alignas(64) std::atomic<uint64_t> tail;
+    /// Set by the producer before it waits for free space.
+    std::atomic<uint32_t> writer_waiting;
+
+    /// Written by the consumer.
+    alignas(64) std::atomic<uint64_t> head;
+    /// Set by the consumer before it waits for data.
+    std::atomic<uint32_t> reader_waiting;
+};
+
+/// A pair of single-producer single-consumer byte rings in a memfd shared by
+/// two processes on the same host, one ring per direction.
+///
+/// Bytes are copied straight into the peer's ring without any system call.
+/// Each side owns an eventfd, and a writer only signals it when the reader
+/// has announced that it is going to sleep. A busy reader is therefore never
+/// notified, and a burst of writes costs at most one notification.
+///
+/// The memfd and both eventfds are passed over a connected AF_UNIX stream
+/// socket with SCM_RIGHTS. The socket is kept open afterwards: when either
+/// side closes the channel or exits, the other one reads EOF from it.
+///
+/// A channel is a byte stream like TcpConnection and not thread safe. Use
+/// AsyncShmConnection to drive it from an EventLoop.
+class ShmChannel {
+public:
+    static constexpr const size_t DEFAULT_RING_SIZE = 1024 * 1024;
+
+    ShmChannel() noexcept = default;
+    ~ShmChannel();
+
+    ShmChannel(const ShmChannel &) = delete;
+    ShmChannel &operator=(const ShmChannel &) = delete;
+
+    ShmChannel(ShmChannel &&other) noexcept;
+    ShmChannel &operator=(ShmChannel &&other) noexcept;
+
+    /// Create a segment with two rings of at least @p ring_size bytes each and
+    /// offer it to the peer over @p conn. Use IsValid() to check if
+    /// succeeded.
+    static ShmChannel Create(TcpConnection &&conn,
+                             size_t          ring_size = DEFAULT_RING_SIZE);
+
+    /// Map the segment offered with Create() by the peer of @p conn. Blocks
+    /// until it is received. Use IsValid() to check if succeeded.
+    static ShmChannel Open(TcpConnection &&conn);
+
+    bool IsValid() const noexcept { return m_segment != nullptr; }
+
+    /// Size of each ring in bytes.
+    size_t GetRingSize() const noexcept { return m_ring_size; }
+
+    /// Copy as much of @p vec as fits into the outgoing ring and wake the
+    /// peer if it is sleeping. Returns number of bytes written, 0 if the ring
+    /// is full or the peer corrupted the ring indices.
+    size_t Write(const struct iovec *vec, int count) noexcept;
+
+    /// Get at most two spans of readable bytes of the incoming ring. Returns
+    /// number of bytes readable.
+    size_t Peek(struct iovec (&vec)[2]) const noexcept;
+
+    /// Drop @p size bytes returned by Peek() and wake the peer if it is
+    /// waiting for free space.
+    void Consume(size_t size) noexcept;
+
+    /// Announce that this side is going to wait for data. Returns false if
+    /// data arrived in the meantime; keep reading in that case.
+    bool PrepareWaitReadable() noexcept;
+
+    /// Announce that this side is going to wait for free space in the
+    /// outgoing ring. Returns false if space was freed in the meantime.
+    bool PrepareWaitWritable() noexcept;
+
+    /// Reset the eventfd of this side after it fired.
+    void ClearNotification() noexcept;
+
+    /// Make the eventfd of this side fire again, e.g. to continue reading in
+    /// the next loop iteration.
+    void NotifySelf() noexcept { Notify(m_notify_fd); }
+
+    /// Readable whenever the peer wakes this side.
+    int GetNotifyFd() const noexcept { return m_notify_fd; }
+
+    /// The AF_UNIX socket the channel was set up with. Reading EOF from it
+    /// means the peer is gone.
+    socket_t GetSocket() const noexcept { return m_conn.GetSocket(); }
+
+private:
+    void Reset() noexcept;
+    bool Map(int memfd, size_t ring_size, bool is_creator) noexcept;
+
+    static void Notify(int fd) noexcept;
+
+private:
+    TcpConnection m_conn;
+
+    void  *m_segment      = nullptr;
+    size_t m_segment_size = 0;
+    size_t m_ring_size    = 0;
+
+    ShmRingControl *m_out      = nullptr;
+    ShmRingControl *m_in       = nullptr;
+    char           *m_out_data = nullptr;
+    char           *m_in_data  = nullptr;
+
+    int m_notify_fd      = -1;
+    int m_peer_notify_fd = -1;
+};
+
+} // namespace eveio
+
+#endif // EVEIO_HAS_SHM_RING
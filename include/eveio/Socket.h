@@ -2,6 +2,10 @@
 
 #include "eveio/Config.h"
 #include "eveio/InetAddr.h"
+#include "eveio/UnixAddr.h"
+
+#include <cerrno>
+#include <cstring>
 
 namespace eveio {
 
@@ -51,6 +55,15 @@ inline bool connect(socket_t sock, const struct sockaddr *addr,
 
 inline bool close(socket_t sock) noexcept { return (::close(sock) == 0); }
 
+/// Returns and clears pending error of @p sock (SO_ERROR).
+inline int getsocketerror(socket_t sock) noexcept {
+    int       err = 0;
+    socklen_t len = sizeof(err);
+    if (::getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len) != 0)
+        return errno;
+    return err;
+}
+
 inline bool setnonblock(socket_t sock, bool on) noexcept {
     int opt = ::fcntl(sock, F_GETFL);
     if (on) {
@@ -76,6 +89,14 @@ inline bool setreuseport(socket_t sock, bool on) noexcept {
     return ::setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) >= 0;
 }
 
+inline bool setrcvbuf(socket_t sock, int size) noexcept {
+    return ::setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) >= 0;
+}
+
+inline bool setsndbuf(socket_t sock, int size) noexcept {
+    return ::setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) >= 0;
+}
+
 inline bool setkeepalive(socket_t sock, bool on) noexcept {
     int opt = on ? 1 : 0;
     return ::setsockopt(sock, SOL_SOCKET, SO_KEEPALIVE, &opt, sizeof(opt)) >= 0;
@@ -93,6 +114,94 @@ inline int64_t write(socket_t sock, const void *data, size_t size) noexcept {
     return ::send(sock, data, size, MSG_NOSIGNAL);
 }
 
+inline int64_t readv(socket_t sock, const struct iovec *iov,
+                     int count) noexcept {
+    return ::readv(sock, iov, count);
+}
+
+/// Use sendmsg() rather than writev() so that MSG_NOSIGNAL could be applied.
+inline int64_t writev(socket_t sock, const struct iovec *iov,
+                      int count) noexcept {
+    struct msghdr msg {};
+    msg.msg_iov    = const_cast<struct iovec *>(iov);
+    msg.msg_iovlen = count;
+    return ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+}
+
+/// Send @p count bytes of file @p fd starting at @p offset. Returns number of
+/// bytes sent, or -1 on error.
+inline int64_t sendfile(socket_t sock, int fd, int64_t offset,
+                        size_t count) noexcept {
+#    if EVEIO_OS_LINUX
+    auto off = static_cast<off_t>(offset);
+    return ::sendfile(sock, fd, &off, count);
+#    elif EVEIO_OS_DARWIN
+    auto len = static_cast<off_t>(count);
+    int  ret =
+        ::sendfile(fd, sock, static_cast<off_t>(offset), &len, nullptr, 0);
+    if (ret < 0 && (len == 0 || errno != EAGAIN))
+        return -1;
+    return static_cast<int64_t>(len);
+#    elif EVEIO_OS_FREEBSD
+    off_t sent = 0;
+    int   ret  = ::sendfile(
+        fd, sock, static_cast<off_t>(offset), count, nullptr, &sent, 0);
+    if (ret < 0 && (sent == 0 || errno != EAGAIN))
+        return -1;
+    return static_cast<int64_t>(sent);
+#    endif
+}
+
+#    if EVEIO_HAS_ZEROCOPY
+inline bool setzerocopy(socket_t sock, bool on) noexcept {
+    int opt = on ? 1 : 0;
+    return ::setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) >= 0;
+}
+
+inline int64_t write_zerocopy(socket_t sock, const void *data,
+                              size_t size) noexcept {
+    return ::send(sock, data, size, MSG_NOSIGNAL | MSG_ZEROCOPY);
+}
+
+/// Read one zero copy completion from the socket error queue. Completed send
+/// calls are in range [@p lo, @p hi]. @p copied is set if the kernel copied
+/// the data anyway. Returns false if there is no more completion.
+inline bool read_zerocopy_completion(socket_t sock, uint32_t &lo, uint32_t &hi,
+                                     bool &copied) noexcept {
+    char          control[128];
+    struct msghdr msg {};
+    msg.msg_control    = control;
+    msg.msg_controllen = sizeof(control);
+
+    for (;;) {
+        if (::recvmsg(sock, &msg, MSG_ERRQUEUE) < 0)
+            return false;
+
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        for (; cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == SOL_IPV6 &&
+                   cm->cmsg_type == IPV6_RECVERR)))
+                continue;
+
+            auto err = reinterpret_cast<const struct sock_extended_err *>(
+                CMSG_DATA(cm));
+            if (err->ee_errno != 0 ||
+                err->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+                continue;
+
+            lo     = err->ee_info;
+            hi     = err->ee_data;
+            copied = (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+            return true;
+        }
+
+        // Not a zero copy notification. Try next one.
+        msg.msg_controllen = sizeof(control);
+    }
+}
+#    endif
+
 inline int64_t recvfrom(socket_t sock, void *buffer, size_t cap,
                         struct sockaddr *addr, size_t *len) noexcept {
     auto tempLen = static_cast<socklen_t>(*len);
@@ -110,11 +219,123 @@ inline int64_t sendto(socket_t sock, const void *buf, size_t size,
         sock, buf, size, MSG_NOSIGNAL, addr, static_cast<socklen_t>(addrLen));
 }
 
+#    if EVEIO_HAS_MMSG
+/// Receive up to @p count datagrams. Returns number of datagrams received, or
+/// -1 on error.
+inline int recvmmsg(socket_t sock, struct mmsghdr *msgs,
+                    unsigned int count) noexcept {
+    return static_cast<int>(::recvmmsg(sock, msgs, count, 0, nullptr));
+}
+
+/// Send up to @p count datagrams. Returns number of datagrams sent, or -1 if
+/// the first one failed.
+inline int sendmmsg(socket_t sock, struct mmsghdr *msgs,
+                    unsigned int count) noexcept {
+    return static_cast<int>(::sendmmsg(sock, msgs, count, MSG_NOSIGNAL));
+}
+#    endif
+
+#    if EVEIO_HAS_UDP_GRO
+/// Let the kernel coalesce consecutive datagrams of the same flow. The segment
+/// size is reported by a UDP_GRO control message.
+inline bool setudpgro(socket_t sock, bool on) noexcept {
+    int opt = on ? 1 : 0;
+    return ::setsockopt(sock, IPPROTO_UDP, UDP_GRO, &opt, sizeof(opt)) >= 0;
+}
+#    endif
+
+/// Send @p count buffers over an AF_UNIX socket with descriptor @p fd
+/// attached (SCM_RIGHTS). Returns number of bytes sent, or -1 on error.
+inline int64_t sendwithfd(socket_t            sock,
+                          const struct iovec *iov,
+                          int                 count,
+                          int                 fd) noexcept {
+    union {
+        char           buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    std::memset(&control, 0, sizeof(control));
+
+    struct msghdr msg {};
+    msg.msg_iov        = const_cast<struct iovec *>(iov);
+    msg.msg_iovlen     = static_cast<decltype(msg.msg_iovlen)>(count);
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level     = SOL_SOCKET;
+    cmsg->cmsg_type      = SCM_RIGHTS;
+    cmsg->cmsg_len       = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+    return ::sendmsg(sock, &msg, MSG_NOSIGNAL);
+}
+
+/// Receive up to @p cap bytes over an AF_UNIX socket. A descriptor attached
+/// to the data is stored in @p fd, which is left untouched otherwise. Returns
+/// number of bytes received, or -1 on error.
+inline int64_t recvwithfd(socket_t sock,
+                          void    *buffer,
+                          size_t   cap,
+                          int     &fd) noexcept {
+    union {
+        char           buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct iovec vec;
+    vec.iov_base = buffer;
+    vec.iov_len  = cap;
+
+    struct msghdr msg {};
+    msg.msg_iov        = &vec;
+    msg.msg_iovlen     = 1;
+    msg.msg_control    = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    int flags = 0;
+#    ifdef MSG_CMSG_CLOEXEC
+    flags |= MSG_CMSG_CLOEXEC;
+#    endif
+
+    auto res = ::recvmsg(sock, &msg, flags);
+    if (res < 0)
+        return -1;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr;
+         cmsg                 = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+            std::memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+    }
+    return res;
+}
+
 inline bool getpeername(socket_t sock, InetAddr &addr) noexcept {
     socklen_t sock_len = sizeof(struct sockaddr_in6);
     return ::getpeername(sock, addr.AsSockaddr(), &sock_len) == 0;
 }
 
+inline bool getsockname(socket_t sock, InetAddr &addr) noexcept {
+    socklen_t sock_len = sizeof(struct sockaddr_in6);
+    return ::getsockname(sock, addr.AsSockaddr(), &sock_len) == 0;
+}
+
+inline bool getpeername(socket_t sock, UnixAddr &addr) noexcept {
+    socklen_t sock_len = UnixAddr::GetMaxAddrSize();
+    if (::getpeername(sock, addr.AsSockaddr(), &sock_len) != 0)
+        return false;
+    addr.SetAddrSize(sock_len);
+    return true;
+}
+
+inline bool getsockname(socket_t sock, UnixAddr &addr) noexcept {
+    socklen_t sock_len = UnixAddr::GetMaxAddrSize();
+    if (::getsockname(sock, addr.AsSockaddr(), &sock_len) != 0)
+        return false;
+    addr.SetAddrSize(sock_len);
+    return true;
+}
+
 } // namespace socket
 #endif
 } // namespace eveio
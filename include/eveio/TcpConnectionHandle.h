@@ -0,0 +1,110 @@
+#pragma once
+
+#include "eveio/ConnectionTable.h"
+#include "eveio/SharedBuffer.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace eveio {
+
+class AsyncTcpConnection;
+class EventLoop;
+
+/// Compact reference to an AsyncTcpConnection: index of its loop, slot in the
+/// ConnectionTable of that loop and generation of the slot, packed into 64
+/// bits.
+///
+/// Unlike a raw pointer, a handle could be kept by any thread. Operations on a
+/// handle of a destroyed connection are dropped, because the slot generation
+/// no longer matches. No reference counting is involved. The loop of the
+/// connection must outlive the handle users.
+class TcpConnectionHandle {
+public:
+    static constexpr const uint32_t LOOP_INDEX_BITS = 12;
+
+    TcpConnectionHandle() noexcept = default;
+    TcpConnectionHandle(uint32_t loop_index,
+                        uint32_t slot,
+                        uint32_t generation) noexcept
+        : m_value((static_cast<uint64_t>(loop_index)
+                   << (ConnectionTable::SLOT_BITS +
+                       ConnectionTable::GENERATION_BITS)) |
+                  (static_cast<uint64_t>(generation)
+                   << ConnectionTable::SLOT_BITS) |
+                  slot) {}
+
+    static TcpConnectionHandle FromValue(uint64_t value) noexcept {
+        TcpConnectionHandle handle;
+        handle.m_value = value;
+        return handle;
+    }
+
+    uint64_t GetValue() const noexcept { return m_value; }
+
+    /// Generation of a live slot is never 0.
+    bool IsNull() const noexcept { return GetGeneration() == 0; }
+
+    uint32_t GetLoopIndex() const noexcept {
+        return static_cast<uint32_t>(
+            m_value >>
+            (ConnectionTable::SLOT_BITS + ConnectionTable::GENERATION_BITS));
+    }
+
+    uint32_t GetSlot() const noexcept {
+        return static_cast<uint32_t>(m_value) &
+               ((1U << ConnectionTable::SLOT_BITS) - 1);
+    }
+
+    uint32_t GetGeneration() const noexcept {
+        return static_cast<uint32_t>(m_value >> ConnectionTable::SLOT_BITS) &
+               ConnectionTable::GENERATION_MASK;
+    }
+
+    /// Returns nullptr if the loop is gone or the handle is null.
+    EventLoop *GetLoop() const noexcept;
+
+    /// Resolve this handle. Returns nullptr if the connection is destroyed.
+    /// Only call this method in the loop thread of the connection.
+    AsyncTcpConnection *Get() const noexcept;
+
+    /// Call @p fn with the connection in its loop thread, if it is still
+    /// alive. Returns false if the loop is gone or, when called in the loop
+    /// thread, if the connection is gone.
+    bool Post(std::function<void(AsyncTcpConnection *)> fn) const;
+
+    /// These methods could be called from any thread. They return false if the
+    /// data is known to be dropped. Data sent from other threads is copied
+    /// once and dropped silently in loop thread if the connection is gone.
+    bool AsyncSend(const void *data, size_t size) const;
+    bool AsyncSend(std::string &&data) const;
+    bool AsyncSend(const SharedBuffer &data) const;
+
+    /// Destroy the connection if it is still alive.
+    bool Destroy() const;
+
+    bool operator==(const TcpConnectionHandle &rhs) const noexcept {
+        return m_value == rhs.m_value;
+    }
+
+    bool operator!=(const TcpConnectionHandle &rhs) const noexcept {
+        return m_value != rhs.m_value;
+    }
+
+private:
+    uint64_t m_value = 0;
+};
+
+} // namespace eveio
+
+namespace std {
+
+template <>
+struct hash<eveio::TcpConnectionHandle> {
+    size_t operator()(const eveio::TcpConnectionHandle &handle) const noexcept {
+        return std::hash<uint64_t>()(handle.GetValue());
+    }
+};
+
+} // namespace std
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "eveio/AsyncTcpConnection.h"
+#include "eveio/InetAddr.h"
+#include "eveio/UnixAddr.h"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+
+namespace eveio {
+
+/// Called with errno of a failed connection attempt. @p will_retry tells
+/// whether another attempt is scheduled.
+using TcpConnectErrorCallback = std::function<void(int error, bool will_retry)>;
+
+/// Non-blocking outbound connector.
+///
+/// Connecting never blocks the loop: the socket is connected in non-blocking
+/// mode and completion is reported by the poller once the socket becomes
+/// writable. Failed attempts are retried with exponential backoff. On success
+/// an AsyncTcpConnection is created in the loop of this connector and passed
+/// to the connection callback.
+///
+/// TcpConnector must be managed by std::shared_ptr. It should be destroyed in
+/// its loop thread, or after Stop() is done.
+class TcpConnector : public std::enable_shared_from_this<TcpConnector> {
+public:
+    TcpConnector(EventLoop &loop, const InetAddr &peer) noexcept;
+
+    /// Connect to an AF_UNIX stream socket. A missing socket file is retried
+    /// like a refused connection, so the server may start later.
+    TcpConnector(EventLoop &loop, const UnixAddr &peer) noexcept;
+    ~TcpConnector();
+
+    TcpConnector(const TcpConnector &) = delete;
+    TcpConnector &operator=(const TcpConnector &) = delete;
+
+    TcpConnector(TcpConnector &&) = delete;
+    TcpConnector &operator=(TcpConnector &&) = delete;
+
+    /// Called in loop thread with the new connection.
+    void SetConnectionCallback(TcpConnectionCallback cb) noexcept {
+        m_conn_callback = std::move(cb);
+    }
+
+    void SetErrorCallback(TcpConnectErrorCallback cb) noexcept {
+        m_error_callback = std::move(cb);
+    }
+
+    /// Delay before the first retry, doubled after each failure until
+    /// @p max_delay. At most @p max_attempts attempts are made by each Start()
+    /// call, 0 means unlimited. Defaults are 500ms, 30s and unlimited.
+    void SetRetry(std::chrono::milliseconds initial_delay,
+                  std::chrono::milliseconds max_delay,
+                  size_t                    max_attempts = 0) noexcept {
+        m_initial_delay = initial_delay.count();
+        m_max_delay     = max_delay.count();
+        m_max_attempts  = max_attempts;
+    }
+
+    /// Give up an attempt if the handshake is not done in @p timeout, instead
+    /// of waiting for the kernel SYN retries. 0 disables it and is the default.
+    void SetConnectTimeout(std::chrono::milliseconds timeout) noexcept {
+        m_connect_timeout = timeout.count();
+    }
+
+    EventLoop      &GetLoop() const noexcept { return *m_loop; }
+    const InetAddr &GetPeerAddr() const noexcept { return m_peer; }
+    const UnixAddr &GetUnixPeerAddr() const noexcept { return m_unix_peer; }
+
+    /// Start connecting. Could be called from any thread. Call it again after
+    /// a connection is made or given up to connect once more.
+    void Start();
+
+    /// Cancel current attempt and pending retry. Could be called from any
+    /// thread.
+    void Stop();
+
+private:
+    enum State {
+        STATE_DISCONNECTED,
+        STATE_CONNECTING,
+    };
+
+    void Connect() noexcept;
+    void HandleConnected() noexcept;
+    void HandleFailure(int error) noexcept;
+    void CloseSocket() noexcept;
+    void CancelTimers() noexcept;
+
+    static bool IsRetryable(int error) noexcept;
+
+private:
+    EventLoop *const          m_loop;
+    const InetAddr            m_peer;
+    const UnixAddr            m_unix_peer;
+    socket_t                  m_socket;
+    std::unique_ptr<Listener> m_listener;
+    State                     m_state;
+    bool                      m_is_stopped;
+
+    TcpConnectionCallback   m_conn_callback;
+    TcpConnectErrorCallback m_error_callback;
+
+    int64_t m_initial_delay;
+    int64_t m_max_delay;
+    int64_t m_retry_delay;
+    int64_t m_connect_timeout;
+    size_t  m_max_attempts;
+    size_t  m_attempts;
+
+    EventLoop::TimerId m_retry_timer;
+    EventLoop::TimerId m_timeout_timer;
+};
+
+} // namespace eveio
@@ -3,8 +3,12 @@
 #include "eveio/Acceptor.h"
 #include "eveio/AsyncTcpConnection.h"
 #include "eveio/EventLoopThreadPool.h"
+#include "eveio/Handoff.h"
+#include "eveio/IdleConnectionWheel.h"
 
 #include <memory>
+#include <unordered_set>
+#include <vector>
 
 namespace eveio {
 
@@ -13,6 +17,18 @@ public:
     TcpServer(EventLoop &loop, const InetAddr &listen_addr);
     TcpServer(EventLoop &loop, const InetAddr &listen_addr,
               std::shared_ptr<EventLoopThreadPool> pool);
+
+    /// Serve AF_UNIX stream connections. Handlers see the same
+    /// AsyncTcpConnection as over TCP.
+    TcpServer(EventLoop &loop, const UnixAddr &listen_addr);
+    TcpServer(EventLoop &loop, const UnixAddr &listen_addr,
+              std::shared_ptr<EventLoopThreadPool> pool);
+
+    /// Serve on a bound or listening socket, e.g. one taken over from another
+    /// process with HandoffReceiver.
+    TcpServer(EventLoop &loop, TcpSocket &&listen_socket);
+    TcpServer(EventLoop &loop, TcpSocket &&listen_socket,
+              std::shared_ptr<EventLoopThreadPool> pool);
     ~TcpServer();
 
     TcpServer(const TcpServer &) = delete;
@@ -25,6 +41,10 @@ public:
         return m_acceptor->GetLocalAddr(addr);
     }
 
+    bool GetLocalAddr(UnixAddr &addr) const noexcept {
+        return m_acceptor->GetLocalAddr(addr);
+    }
+
     std::shared_ptr<EventLoopThreadPool>
     GetEventLoopThreadPool() const noexcept {
         return m_pool;
@@ -32,6 +52,11 @@ public:
 
     EventLoop &GetAcceptorPool() const noexcept { return *m_loop; }
 
+    /// Callbacks must be set before Start(). They are shared by all
+    /// connections instead of copied into each of them.
+    ///
+    /// Connection callback is called in the worker loop thread of the new
+    /// connection, after all other callbacks are set.
     void SetConnectionCallback(TcpConnectionCallback cb) noexcept {
         m_conn_callback = std::move(cb);
     }
@@ -44,8 +69,134 @@ public:
         m_write_complete_callback = std::move(cb);
     }
 
+    /// Close callback is called in the worker loop thread right before the
+    /// connection is deleted.
+    void SetCloseCallback(TcpConnectionCallback cb) noexcept {
+        m_close_callback = std::move(cb);
+    }
+
+    /// See AsyncTcpConnection::SetHighWaterMarkCallback().
+    void SetHighWaterMarkCallback(
+        TcpWaterMarkCallback cb,
+        size_t mark = AsyncTcpConnection::DEFAULT_HIGH_WATER_MARK) noexcept {
+        m_high_water_mark_callback = std::move(cb);
+        m_high_water_mark          = mark;
+    }
+
+    /// See AsyncTcpConnection::SetLowWaterMarkCallback().
+    void SetLowWaterMarkCallback(
+        TcpWaterMarkCallback cb,
+        size_t mark = AsyncTcpConnection::DEFAULT_LOW_WATER_MARK) noexcept {
+        m_low_water_mark_callback = std::move(cb);
+        m_low_water_mark          = mark;
+    }
+
+    /// See AsyncTcpConnection::SetPauseReadingOnHighWaterMark().
+    void SetPauseReadingOnHighWaterMark(bool on) noexcept {
+        m_pause_on_high_water_mark = on;
+    }
+
+    /// See AsyncTcpConnection::SetReadBudget().
+    void SetReadBudget(size_t max_bytes, size_t max_calls) noexcept {
+        m_read_budget_bytes = max_bytes;
+        m_read_budget_calls = max_calls;
+    }
+
+    /// See AsyncTcpConnection::SetAutoCork().
+    void SetAutoCork(bool on) noexcept { m_auto_cork = on; }
+
+    /// Destroy connections that have neither read nor written anything for
+    /// @p timeout. Each worker loop checks its connections with an
+    /// IdleConnectionWheel. Connections may live up to one wheel tick
+    /// (timeout / 8) longer. Must be set before Start(). 0 disables it.
+    void SetIdleTimeout(std::chrono::milliseconds timeout) noexcept {
+        m_idle_timeout = timeout;
+    }
+
     void Start();
 
+    /// Send @p data to every connection of this server. Could be called from
+    /// any thread after Start().
+    ///
+    /// Only one task is posted to each worker loop and all write queues
+    /// reference the same bytes, so a broadcast costs O(loops) memory no
+    /// matter how many connections there are. Connections accepted after this
+    /// call may or may not receive the data.
+    void Broadcast(const SharedBuffer &data) noexcept;
+
+    /// Copy @p data once and broadcast it.
+    void Broadcast(const void *data, size_t size) noexcept {
+        Broadcast(SharedBuffer(data, size));
+    }
+
+    /// Take ownership of @p data and broadcast it without copying.
+    void Broadcast(std::string &&data) noexcept {
+        Broadcast(SharedBuffer(std::move(data)));
+    }
+
+    /// Pass the listening socket to another process and stop accepting. The
+    /// kernel keeps queueing new connections on the socket, so none of them
+    /// is lost while the other process starts serving. Blocks until the
+    /// socket is sent. Must not be called in the acceptor loop thread.
+    bool HandOffListener(HandoffSender &sender, const std::string &name);
+
+    /// Pass every connection that has nothing left to send to another
+    /// process, together with its unconsumed input. Such connections are
+    /// destroyed here without being closed. Connections still sending stay
+    /// and could be handed off by a later call or left to drain. Returns the
+    /// number of connections handed off. Blocks until all worker loops are
+    /// done. Must not be called in a worker loop thread.
+    size_t HandOffIdleConnections(HandoffSender     &sender,
+                                  const std::string &name);
+
+    /// Serve a connection taken over from another process as if it was just
+    /// accepted. @p buffered is handed to the message callback before
+    /// anything else is read. Could be called from any thread after Start().
+    void AdoptConnection(TcpConnection &&conn, std::string &&buffered);
+
+private:
+    /// Connections owned by one worker loop. Only accessed in that loop.
+    struct LoopContext {
+        std::unordered_set<AsyncTcpConnection *> connections;
+        std::unique_ptr<IdleConnectionWheel>     idle_wheel;
+    };
+
+    /// Everything a worker loop needs to set up new connections. Tasks
+    /// handing sockets to the loop hold a reference instead of the server,
+    /// so that they stay valid after the server is destroyed.
+    struct LoopSetup {
+        EventLoop                                    *loop;
+        std::shared_ptr<LoopContext>                  context;
+        std::shared_ptr<const TcpConnectionCallbacks> callbacks;
+        std::shared_ptr<const TcpConnectionCallback>  destroy_hook;
+        TcpConnectionCallback                         conn_callback;
+
+        size_t high_water_mark;
+        size_t low_water_mark;
+        size_t read_budget_bytes;
+        size_t read_budget_calls;
+        bool   pause_on_high_water_mark;
+        bool   auto_cork;
+
+        /// Set once the server is destroyed. Sockets still on the way to the
+        /// loop are closed instead of served.
+        std::atomic_bool is_closed{false};
+    };
+
+    TcpServer(EventLoop                           &loop,
+              std::shared_ptr<Acceptor>            acceptor,
+              std::shared_ptr<EventLoopThreadPool> pool);
+
+    /// Create idle wheel of the loop. Called in the worker loop thread.
+    static void StartIdleWheel(EventLoop                   *loop,
+                               std::shared_ptr<LoopContext> context,
+                               std::chrono::milliseconds    timeout);
+
+    /// Serve @p sock in the loop of @p setup, or close it if the server is
+    /// gone. Called in the worker loop thread.
+    static AsyncTcpConnection *NewConnection(const LoopSetup &setup,
+                                             socket_t         sock) noexcept;
+
 private:
     EventLoop *const                     m_loop;
     std::shared_ptr<EventLoopThreadPool> m_pool;
@@ -56,6 +207,22 @@ private:
     TcpConnectionCallback    m_conn_callback;
     TcpMessageCallback       m_msg_callback;
     TcpWriteCompleteCallback m_write_complete_callback;
+    TcpConnectionCallback    m_close_callback;
+
+    TcpWaterMarkCallback m_high_water_mark_callback;
+    TcpWaterMarkCallback m_low_water_mark_callback;
+    size_t               m_high_water_mark;
+    size_t               m_low_water_mark;
+    bool                 m_pause_on_high_water_mark;
+
+    size_t m_read_budget_bytes;
+    size_t m_read_budget_calls;
+    bool   m_auto_cork;
+
+    std::chrono::milliseconds m_idle_timeout;
+
+    /// Indexed the same as EventLoopThreadPool::GetAllLoops().
+    std::vector<std::shared_ptr<LoopSetup>> m_loop_setups;
 };
 
 } // namespace eveio
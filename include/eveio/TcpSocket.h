@@ -11,6 +11,7 @@ public:
     TcpConnection() noexcept = default;
 
     explicit TcpConnection(const InetAddr &peer) noexcept;
+    explicit TcpConnection(const UnixAddr &peer) noexcept;
     explicit TcpConnection(socket_t conn_sock) noexcept : m_socket(conn_sock) {}
 
     TcpConnection(const TcpConnection &) = delete;
@@ -37,14 +38,30 @@ public:
         return socket::getpeername(m_socket, addr);
     }
 
+    bool GetPeerAddr(UnixAddr &addr) const noexcept {
+        return socket::getpeername(m_socket, addr);
+    }
+
     int64_t Send(const void *data, size_t size) noexcept {
         return socket::write(m_socket, data, size);
     }
 
+    int64_t SendV(const struct iovec *iov, int count) noexcept {
+        return socket::writev(m_socket, iov, count);
+    }
+
+    int64_t SendFile(int fd, int64_t offset, size_t count) noexcept {
+        return socket::sendfile(m_socket, fd, offset, count);
+    }
+
     int64_t Receive(void *buffer, size_t size) noexcept {
         return socket::read(m_socket, buffer, size);
     }
 
+    int64_t ReceiveV(const struct iovec *iov, int count) noexcept {
+        return socket::readv(m_socket, iov, count);
+    }
+
     bool ShutdownWrite() noexcept { return socket::shutdown_write(m_socket); }
 
     bool SetNoDelay(bool on) noexcept {
@@ -61,6 +78,13 @@ public:
 
     socket_t GetSocket() const noexcept { return m_socket; }
 
+    /// Give up ownership of the socket without closing it.
+    socket_t Release() noexcept {
+        socket_t sock = m_socket;
+        m_socket      = INVALID_SOCKET;
+        return sock;
+    }
+
 private:
     socket_t m_socket = INVALID_SOCKET;
 };
@@ -70,6 +94,13 @@ public:
     TcpSocket() noexcept = default;
     TcpSocket(const InetAddr &addr) noexcept;
 
+    /// Stream socket bound to an AF_UNIX address.
+    TcpSocket(const UnixAddr &addr) noexcept;
+
+    /// Take ownership of a bound or listening socket, e.g. one received from
+    /// another process.
+    explicit TcpSocket(socket_t sock) noexcept : m_socket(sock) {}
+
     TcpSocket(const TcpSocket &) = delete;
     TcpSocket &operator=(const TcpSocket &) = delete;
 
@@ -88,7 +119,11 @@ public:
     TcpConnection Accept() noexcept;
 
     bool GetLocalAddr(InetAddr &addr) const noexcept {
-        return socket::getpeername(m_socket, addr);
+        return socket::getsockname(m_socket, addr);
+    }
+
+    bool GetLocalAddr(UnixAddr &addr) const noexcept {
+        return socket::getsockname(m_socket, addr);
     }
 
     bool SetNonBlock(bool on) noexcept {
@@ -107,6 +142,13 @@ public:
 
     socket_t GetSocket() const noexcept { return m_socket; }
 
+    /// Give up ownership of the socket without closing it.
+    socket_t Release() noexcept {
+        socket_t sock = m_socket;
+        m_socket      = INVALID_SOCKET;
+        return sock;
+    }
+
 private:
     socket_t m_socket = INVALID_SOCKET;
 };
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "eveio/Socket.h"
+
+namespace eveio {
+
+class UdpSocket {
+public:
+    UdpSocket() noexcept = default;
+
+    /// Create a non-blocking UDP socket bound to @p local. With @p reuse_port
+    /// several sockets could be bound to the same address, e.g. one per
+    /// worker loop, and the kernel spreads datagrams among them. Use IsValid()
+    /// to check if succeeded.
+    explicit UdpSocket(const InetAddr &local, bool reuse_port = false) noexcept;
+
+    UdpSocket(const UdpSocket &) = delete;
+    UdpSocket &operator=(const UdpSocket &) = delete;
+
+    UdpSocket(UdpSocket &&other) noexcept : m_socket(other.m_socket) {
+        other.m_socket = INVALID_SOCKET;
+    }
+
+    UdpSocket &operator=(UdpSocket &&other) noexcept;
+
+    ~UdpSocket() {
+        if (m_socket != INVALID_SOCKET)
+            socket::close(m_socket);
+    }
+
+    bool IsValid() const noexcept { return m_socket != INVALID_SOCKET; }
+
+    bool GetLocalAddr(InetAddr &addr) const noexcept {
+        return socket::getsockname(m_socket, addr);
+    }
+
+    int64_t SendTo(const void *data, size_t size,
+                   const InetAddr &peer) noexcept {
+        return socket::sendto(
+            m_socket, data, size, peer.AsSockaddr(), peer.GetAddrSize());
+    }
+
+    int64_t ReceiveFrom(void *buffer, size_t size, InetAddr &peer) noexcept {
+        size_t len = sizeof(struct sockaddr_in6);
+        return socket::recvfrom(m_socket, buffer, size, peer.AsSockaddr(),
+                                &len);
+    }
+
+    bool SetReceiveBufferSize(int size) noexcept {
+        return socket::setrcvbuf(m_socket, size);
+    }
+
+    bool SetSendBufferSize(int size) noexcept {
+        return socket::setsndbuf(m_socket, size);
+    }
+
+    /// Enable UDP_GRO. Returns false if not supported.
+    bool SetReceiveOffload(bool on) noexcept {
+#if EVEIO_HAS_UDP_GRO
+        return socket::setudpgro(m_socket, on);
+#else
+        (void)on;
+        return false;
+#endif
+    }
+
+    socket_t GetSocket() const noexcept { return m_socket; }
+
+private:
+    socket_t m_socket = INVALID_SOCKET;
+};
+
+} // namespace eveio
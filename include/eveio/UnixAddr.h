@@ -0,0 +1,89 @@
+#pragma once
+
+#include "eveio/Config.h"
+
+#include <cstddef>
+#include <string>
+
+#if !EVEIO_OS_WIN32
+#    include <sys/un.h>
+#endif
+
+namespace eveio {
+
+/// Address of an AF_UNIX stream socket. Connections on such sockets skip the
+/// TCP/IP stack entirely, which makes them much cheaper than TCP loopback for
+/// processes on the same host. Acceptor, TcpServer, TcpConnector and
+/// TcpConnection accept it wherever they accept an InetAddr.
+class UnixAddr {
+public:
+    UnixAddr() noexcept = default;
+
+    /// Filesystem path. Binding fails if the path already exists, so remove a
+    /// stale socket file first. Use IsValid() to check if @p path fits.
+    explicit UnixAddr(const std::string &path) noexcept;
+
+    UnixAddr(const UnixAddr &) noexcept = default;
+    UnixAddr &operator=(const UnixAddr &) noexcept = default;
+
+    /// Name in the Linux abstract namespace. It leaves nothing on the
+    /// filesystem and disappears once the last socket is closed. Invalid on
+    /// other platforms.
+    static UnixAddr Abstract(const std::string &name) noexcept;
+
+    /// Inverse of GetPath(): a leading '@' selects the abstract namespace.
+    static UnixAddr Parse(const std::string &text) noexcept {
+        if (!text.empty() && text[0] == '@')
+            return Abstract(text.substr(1));
+        return UnixAddr(text);
+    }
+
+    sa_family_t GetFamily() const noexcept { return m_addr.sun_family; }
+
+    bool IsValid() const noexcept { return GetFamily() == AF_UNIX; }
+
+    /// Abstract names start with a NUL byte.
+    bool IsAbstract() const noexcept {
+        return IsValid() && m_size > PathOffset() && m_addr.sun_path[0] == '\0';
+    }
+
+    /// Filesystem path, or abstract name prefixed with '@'. Empty for an
+    /// unnamed socket, e.g. the peer of an accepted connection.
+    std::string GetPath() const noexcept;
+
+    const struct sockaddr *AsSockaddr() const noexcept {
+        return reinterpret_cast<const struct ::sockaddr *>(&m_addr);
+    }
+
+    struct sockaddr *AsSockaddr() noexcept {
+        return reinterpret_cast<struct ::sockaddr *>(&m_addr);
+    }
+
+    /// Abstract names are not NUL terminated, so the size is part of the
+    /// address.
+    size_t GetAddrSize() const noexcept { return m_size; }
+
+    /// For internal usage. Set size returned by getsockname() or
+    /// getpeername().
+    void SetAddrSize(size_t size) noexcept { m_size = size; }
+
+    static constexpr size_t GetMaxAddrSize() noexcept {
+        return sizeof(struct ::sockaddr_un);
+    }
+
+    bool operator==(const UnixAddr &rhs) const noexcept;
+    bool operator!=(const UnixAddr &rhs) const noexcept {
+        return !(*this == rhs);
+    }
+
+private:
+    static constexpr size_t PathOffset() noexcept {
+        return offsetof(struct ::sockaddr_un, sun_path);
+    }
+
+private:
+    struct ::sockaddr_un m_addr {};
+    size_t               m_size = 0;
+};
+
+} // namespace eveio
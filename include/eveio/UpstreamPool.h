@@ -0,0 +1,121 @@
+#pragma once
+
+#include "eveio/TcpConnector.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace eveio {
+
+/// Called with a connection to the upstream, or with nullptr and errno if
+/// failed to connect.
+using UpstreamCallback = std::function<void(AsyncTcpConnection *, int error)>;
+
+/// Per-loop pool of outbound connections keyed by upstream address.
+///
+/// Each EventLoop should own its own pool, so checkout and return never take
+/// a lock. Idle connections keep reading, so a peer that closes an idle
+/// connection (reported by EPOLLRDHUP) or sends unexpected data gets the
+/// connection destroyed and removed from the pool right away.
+///
+/// UpstreamPool is NOT thread safe. It must be created, used and destroyed in
+/// its loop thread.
+class UpstreamPool {
+public:
+    static constexpr const size_t DEFAULT_MAX_IDLE = 64;
+
+    /// Delay before prewarming is retried after a failed connect. It doubles
+    /// on every further failure up to MAX_PREWARM_RETRY_DELAY.
+    static constexpr const std::chrono::milliseconds PREWARM_RETRY_DELAY{100};
+    static constexpr const std::chrono::milliseconds MAX_PREWARM_RETRY_DELAY{
+        10000};
+
+    explicit UpstreamPool(EventLoop &loop);
+    ~UpstreamPool();
+
+    UpstreamPool(const UpstreamPool &) = delete;
+    UpstreamPool &operator=(const UpstreamPool &) = delete;
+
+    UpstreamPool(UpstreamPool &&) = delete;
+    UpstreamPool &operator=(UpstreamPool &&) = delete;
+
+    /// Keep at least @p min_idle warm connections to every upstream that was
+    /// ever checked out or prewarmed, and at most @p max_idle idle ones.
+    /// Defaults are 0 and DEFAULT_MAX_IDLE.
+    void SetIdleLimits(size_t min_idle, size_t max_idle) noexcept {
+        m_min_idle = min_idle;
+        m_max_idle = std::max(max_idle, min_idle);
+    }
+
+    /// Give up connecting after @p timeout. 0 waits for the kernel.
+    void SetConnectTimeout(std::chrono::milliseconds timeout) noexcept {
+        m_connect_timeout = timeout;
+    }
+
+    EventLoop &GetLoop() const noexcept { return *m_loop; }
+
+    /// Take an idle connection to @p upstream. Returns nullptr if there is
+    /// none.
+    AsyncTcpConnection *TryCheckout(const InetAddr &upstream);
+
+    /// Take an idle connection to @p upstream, or open a new one. @p cb is
+    /// called immediately if there is an idle connection.
+    ///
+    /// A checked out connection has no callbacks set. It belongs to the
+    /// caller until it is returned or destroyed.
+    void Checkout(const InetAddr &upstream, UpstreamCallback cb);
+
+    /// Give back a checked out connection once the exchange on it is
+    /// complete. The connection is destroyed instead if it still has unread
+    /// data, belongs to another loop or the upstream already has enough idle
+    /// connections.
+    void Return(AsyncTcpConnection *conn);
+
+    /// Open connections until @p upstream has the minimum number of idle
+    /// connections. It is called again whenever an idle connection is gone,
+    /// and after a backoff delay if a connect fails.
+    void Prewarm(const InetAddr &upstream);
+
+    size_t GetIdleCount(const InetAddr &upstream) const noexcept;
+    size_t GetIdleCount() const noexcept { return m_idle_owner.size(); }
+
+private:
+    struct Upstream {
+        std::vector<AsyncTcpConnection *> idle;
+        size_t                            num_warming = 0;
+
+        /// Pending prewarm retry, 0 if none.
+        EventLoop::TimerId        retry_timer = 0;
+        std::chrono::milliseconds retry_delay = PREWARM_RETRY_DELAY;
+    };
+
+    using ConnectorSet = std::unordered_set<std::shared_ptr<TcpConnector>>;
+
+    void Connect(const InetAddr &upstream, UpstreamCallback cb);
+    void ReleaseConnector(std::shared_ptr<TcpConnector> connector);
+    void AddIdle(const InetAddr &upstream, AsyncTcpConnection *conn);
+    void RemoveIdle(AsyncTcpConnection *conn);
+    void OnPrewarmed(const InetAddr &upstream, AsyncTcpConnection *conn);
+
+private:
+    EventLoop *const          m_loop;
+    size_t                    m_min_idle;
+    size_t                    m_max_idle;
+    std::chrono::milliseconds m_connect_timeout;
+
+    std::unordered_map<InetAddr, Upstream>             m_upstreams;
+    std::unordered_map<AsyncTcpConnection *, InetAddr> m_idle_owner;
+    ConnectorSet                                       m_connectors;
+
+    /// Callbacks of idle connections.
+    std::shared_ptr<const TcpConnectionCallbacks> m_idle_callbacks;
+    /// Empty callbacks of checked out connections.
+    std::shared_ptr<const TcpConnectionCallbacks> m_checkout_callbacks;
+};
+
+} // namespace eveio
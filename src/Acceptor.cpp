@@ -4,10 +4,10 @@
 
 using namespace eveio;
 
-eveio::Acceptor::Acceptor(EventLoop &loop, const InetAddr &local_addr)
+eveio::Acceptor::Acceptor(EventLoop &loop, TcpSocket &&socket)
     : m_loop(&loop),
       m_is_listening(false),
-      m_socket(local_addr),
+      m_socket(std::move(socket)),
       m_listener(*m_loop, m_socket.GetSocket()),
       m_new_conn_callback() {
     m_listener.TieObject(this);
@@ -0,0 +1,206 @@
+#include "eveio/AsyncShmConnection.h"
+
+#if EVEIO_HAS_SHM_RING
+
+using namespace eveio;
+
+eveio::AsyncShmConnection::AsyncShmConnection(EventLoop   &loop,
+                                              ShmChannel &&channel)
+    : m_loop(&loop),
+      m_channel(std::move(channel)),
+      m_notify_listener(loop, m_channel.GetNotifyFd()),
+      m_socket_listener(loop, m_channel.GetSocket()),
+      m_msg_callback(),
+      m_write_complete_callback(),
+      m_close_callback(),
+      m_read_buffer(&loop.GetBufferPool(), BufferPool::CATEGORY_READ),
+      m_write_buffer(&loop.GetBufferPool(), BufferPool::CATEGORY_WRITE),
+      m_num_wakeups(0),
+      m_is_quit(false) {
+
+    m_notify_listener.TieObject(this);
+    m_notify_listener.SetReadCallback(+[](Listener *listener) {
+        auto connection =
+            static_cast<AsyncShmConnection *>(listener->GetTiedObject());
+        connection->HandleWakeup();
+    });
+
+    m_socket_listener.TieObject(this);
+    m_socket_listener.SetReadCallback(+[](Listener *listener) {
+        auto connection =
+            static_cast<AsyncShmConnection *>(listener->GetTiedObject());
+        connection->HandleSocketRead();
+    });
+
+    m_loop->RunInLoop([this]() {
+        this->m_notify_listener.EnableReading();
+        this->m_socket_listener.EnableReading();
+
+        // Data may have been written before the listener was ready, and the
+        // peer only notifies once this side has announced to wait. Handle
+        // the ring from the loop, once callbacks are set.
+        this->m_channel.NotifySelf();
+    });
+}
+
+eveio::AsyncShmConnection::~AsyncShmConnection() = default;
+
+void eveio::AsyncShmConnection::AsyncSend(const void *data,
+                                          size_t      size) noexcept {
+    struct iovec vec;
+    vec.iov_base = const_cast<void *>(data);
+    vec.iov_len  = size;
+    AsyncSend(&vec, 1);
+}
+
+void eveio::AsyncShmConnection::AsyncSend(const struct iovec *vec,
+                                          int                 count) noexcept {
+    if (m_loop->IsInLoopThread()) {
+        SendInLoop(vec, count);
+        return;
+    }
+
+    std::string buf;
+    for (int i = 0; i < count; ++i)
+        buf.append(static_cast<const char *>(vec[i].iov_base),
+                   vec[i].iov_len);
+    AsyncSend(std::move(buf));
+}
+
+void eveio::AsyncShmConnection::AsyncSend(std::string &&data) noexcept {
+    if (m_loop->IsInLoopThread()) {
+        AsyncSend(data.data(), data.size());
+        return;
+    }
+
+    auto buf = std::make_shared<std::string>(std::move(data));
+    m_loop->RunInLoop([this, buf]() {
+        struct iovec vec;
+        vec.iov_base = &(*buf)[0];
+        vec.iov_len  = buf->size();
+        this->SendInLoop(&vec, 1);
+    });
+}
+
+void eveio::AsyncShmConnection::Destroy() noexcept {
+    if (m_is_quit.exchange(true, std::memory_order_relaxed) == false) {
+        m_loop->QueueInLoop([this]() {
+            if (m_close_callback)
+                m_close_callback(this);
+            delete this;
+        });
+    }
+}
+
+void eveio::AsyncShmConnection::HandleWakeup() noexcept {
+    m_channel.ClearNotification();
+    ++m_num_wakeups;
+
+    HandleRead();
+    if (!m_write_buffer.IsEmpty())
+        Flush();
+}
+
+void eveio::AsyncShmConnection::HandleRead() noexcept {
+    if (IsDestroying())
+        return;
+
+    // Drain at most one ring per wakeup, so that a peer that never stops
+    // writing could not starve other listeners of this loop.
+    struct iovec vec[2];
+    size_t       total    = 0;
+    bool         is_armed = false;
+    while (total < m_channel.GetRingSize()) {
+        size_t size = m_channel.Peek(vec);
+        if (size == 0) {
+            is_armed = m_channel.PrepareWaitReadable();
+            if (is_armed)
+                break;
+            continue;
+        }
+
+        m_read_buffer.Append(vec[0].iov_base, vec[0].iov_len);
+        if (vec[1].iov_len > 0)
+            m_read_buffer.Append(vec[1].iov_base, vec[1].iov_len);
+        m_channel.Consume(size);
+        total += size;
+    }
+
+    // The peer does not notify a reader that has not announced to wait.
+    // Continue in the next loop iteration instead.
+    if (!is_armed)
+        m_channel.NotifySelf();
+
+    if (total > 0) {
+        if (m_msg_callback) {
+            m_msg_callback(this, m_read_buffer);
+        } else {
+            m_read_buffer.Clear();
+        }
+    }
+}
+
+void eveio::AsyncShmConnection::HandleSocketRead() noexcept {
+    // Nothing but EOF is expected on the socket.
+    char    buffer[64];
+    int64_t ret = socket::read(m_channel.GetSocket(), buffer, sizeof(buffer));
+    if (ret > 0 || (ret < 0 && (errno == EAGAIN || errno == EINTR)))
+        return;
+
+    // Data written before the peer closed is still in the ring.
+    HandleRead();
+    m_notify_listener.DisableAll();
+    m_socket_listener.DisableAll();
+    Destroy();
+}
+
+void eveio::AsyncShmConnection::SendInLoop(const struct iovec *vec,
+                                           int                 count) noexcept {
+    if (IsDestroying())
+        return;
+
+    // Keep the order of bytes already waiting for space.
+    if (!m_write_buffer.IsEmpty()) {
+        for (int i = 0; i < count; ++i)
+            m_write_buffer.Append(vec[i].iov_base, vec[i].iov_len);
+        return;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < count; ++i)
+        total += vec[i].iov_len;
+
+    size_t written = m_channel.Write(vec, count);
+    if (written == total) {
+        if (m_write_complete_callback)
+            m_write_complete_callback(this);
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        size_t skip = std::min(written, vec[i].iov_len);
+        written -= skip;
+        m_write_buffer.Append(static_cast<const char *>(vec[i].iov_base) +
+                                  skip,
+                              vec[i].iov_len - skip);
+    }
+    Flush();
+}
+
+void eveio::AsyncShmConnection::Flush() noexcept {
+    while (!m_write_buffer.IsEmpty()) {
+        struct iovec vec;
+        vec.iov_base = m_write_buffer.Data<char>();
+        vec.iov_len  = m_write_buffer.Size();
+        m_write_buffer.ReadOut(m_channel.Write(&vec, 1));
+
+        // The peer wakes this side once it frees some space.
+        if (!m_write_buffer.IsEmpty() && m_channel.PrepareWaitWritable())
+            return;
+    }
+
+    if (m_write_complete_callback)
+        m_write_complete_callback(this);
+}
+
+#endif // EVEIO_HAS_SHM_RING
@@ -2,26 +2,156 @@
 
 #include <algorithm>
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
+#include <new>
 
 using namespace eveio;
 
+eveio::AsyncTcpConnBuffer::AsyncTcpConnBuffer(
+    AsyncTcpConnBuffer &&other) noexcept
+    : m_pool(other.m_pool),
+      m_category(other.m_category),
+      m_storage(other.m_storage),
+      m_capacity(other.m_capacity),
+      m_head(other.m_head),
+      m_tail(other.m_tail) {
+    other.m_storage  = nullptr;
+    other.m_capacity = 0;
+    other.m_head     = 0;
+    other.m_tail     = 0;
+}
+
+AsyncTcpConnBuffer &
+eveio::AsyncTcpConnBuffer::operator=(AsyncTcpConnBuffer &&other) noexcept {
+    if (this != &other) {
+        Release();
+        m_pool     = other.m_pool;
+        m_category = other.m_category;
+        m_storage  = other.m_storage;
+        m_capacity = other.m_capacity;
+        m_head     = other.m_head;
+        m_tail     = other.m_tail;
+
+        other.m_storage  = nullptr;
+        other.m_capacity = 0;
+        other.m_head     = 0;
+        other.m_tail     = 0;
+    }
+    return (*this);
+}
+
 void eveio::AsyncTcpConnBuffer::Append(const void *data, size_t size) noexcept {
-    m_storage.reserve(std::max(m_tail + size, size_t(4096)));
-    memcpy(m_storage.data() + m_tail, data, size);
+    if (size == 0 || !Reserve(size))
+        return;
+
+    memcpy(m_storage + m_tail, data, size);
     m_tail += size;
 }
 
+bool eveio::AsyncTcpConnBuffer::Reserve(size_t size) noexcept {
+    if (Capacity() >= size)
+        return true;
+
+    size_t data_size = Size();
+
+    // Move data to the front if there is enough space.
+    if (m_storage != nullptr && m_capacity - data_size >= size) {
+        memmove(m_storage, m_storage + m_head, data_size);
+        m_head = 0;
+        m_tail = data_size;
+        return true;
+    }
+
+    // Grow geometrically so that appending a large message piece by piece
+    // does not copy the buffer on every call.
+    size_t wanted       = std::max(data_size + size, 2 * m_capacity);
+    size_t new_capacity = 0;
+    char  *new_storage  = nullptr;
+    if (m_pool != nullptr) {
+        new_storage = m_pool->Acquire(wanted, m_category, new_capacity);
+    } else {
+        new_capacity = std::max(wanted, size_t(BufferPool::MIN_BLOCK_SIZE));
+        new_storage  = static_cast<char *>(std::malloc(new_capacity));
+    }
+
+    if (new_storage == nullptr)
+        return false;
+
+    if (data_size != 0)
+        memcpy(new_storage, m_storage + m_head, data_size);
+
+    Release();
+    m_storage  = new_storage;
+    m_capacity = new_capacity;
+    m_head     = 0;
+    m_tail     = data_size;
+    return true;
+}
+
+void eveio::AsyncTcpConnBuffer::Release() noexcept {
+    if (m_storage != nullptr) {
+        if (m_pool != nullptr)
+            m_pool->Release(m_storage, m_capacity, m_category);
+        else
+            std::free(m_storage);
+    }
+
+    m_storage  = nullptr;
+    m_capacity = 0;
+    m_head     = 0;
+    m_tail     = 0;
+}
+
+namespace {
+
+/// How often connections paused by BufferPool process limit check memory.
+const std::chrono::milliseconds MEMORY_RETRY_INTERVAL(10);
+
+/// Callback set of connections that never had any callback set.
+const std::shared_ptr<const TcpConnectionCallbacks> &EmptyCallbacks() {
+    static const std::shared_ptr<const TcpConnectionCallbacks> callbacks =
+        std::make_shared<TcpConnectionCallbacks>();
+    return callbacks;
+}
+
+} // namespace
+
 eveio::AsyncTcpConnection::AsyncTcpConnection(EventLoop      &loop,
                                               TcpConnection &&conn)
     : m_loop(&loop),
       m_conn(std::move(conn)),
       m_listener(loop, m_conn.GetSocket()),
-      m_msg_callback(),
-      m_write_complete_callback(),
-      m_read_buffer(),
-      m_write_buffer(),
-      m_is_quit(false) {
+      m_callbacks(EmptyCallbacks()),
+      m_destroy_hook(),
+      m_read_buffer(&loop.GetBufferPool(), BufferPool::CATEGORY_READ),
+      m_write_buffer(&loop.GetBufferPool(), BufferPool::CATEGORY_WRITE),
+      m_write_queue(),
+      m_write_queue_head(0),
+      m_write_queue_bytes(0),
+      m_high_water_mark(DEFAULT_HIGH_WATER_MARK),
+      m_low_water_mark(DEFAULT_LOW_WATER_MARK),
+      m_read_budget_bytes(DEFAULT_READ_BUDGET_BYTES),
+      m_read_budget_calls(DEFAULT_READ_BUDGET_CALLS),
+      m_max_read_buffer_size(SIZE_MAX),
+      m_read_buffer_full_count(0),
+      m_zerocopy_pending(),
+      m_zerocopy_threshold(DEFAULT_ZEROCOPY_THRESHOLD),
+      m_zerocopy_seq(0),
+      m_read_paused(0),
+      m_last_active(0),
+      m_idle_bucket(UINT32_MAX),
+      m_idle_index(0),
+      m_slot(ConnectionTable::INVALID_SLOT),
+      m_generation(0),
+      m_owns_callbacks(false),
+      m_pause_on_high_water_mark(false),
+      m_above_high_water_mark(false),
+      m_auto_cork(false),
+      m_flush_pending(false),
+      m_zerocopy(false),
+      m_is_quit(false),
+      m_stats() {
 
     m_conn.SetNonBlock(true);
     m_conn.SetKeepAlive(true);
@@ -40,75 +170,723 @@ eveio::AsyncTcpConnection::AsyncTcpConnection(EventLoop      &loop,
         connection->SendInLoop();
     });
 
-    m_loop->RunInLoop([this]() { this->m_listener.EnableReading(); });
+    m_loop->RunInLoop([this]() {
+        this->m_slot = m_loop->GetConnectionTable().Insert(this, m_generation);
+        this->m_listener.EnableReading();
+    });
+}
+
+AsyncTcpConnection *
+eveio::AsyncTcpConnection::Create(EventLoop &loop, TcpConnection &&conn) {
+    if (!loop.IsInLoopThread())
+        return new AsyncTcpConnection(loop, std::move(conn));
+
+    void *memory =
+        loop.GetConnectionPool().Acquire(sizeof(AsyncTcpConnection));
+    return ::new (memory) AsyncTcpConnection(loop, std::move(conn));
 }
 
-eveio::AsyncTcpConnection::~AsyncTcpConnection() = default;
+eveio::AsyncTcpConnection::~AsyncTcpConnection() {
+    m_loop->GetConnectionTable().Remove(m_slot);
+
+    if (m_flush_pending)
+        m_loop->CancelAfterEvents(this);
+
+    for (size_t i = m_write_queue_head; i < m_write_queue.size(); ++i) {
+        if (m_write_queue[i].IsFile())
+            ::close(m_write_queue[i].file);
+    }
+}
 
 void eveio::AsyncTcpConnection::AsyncSend(const void *data,
                                           size_t      size) noexcept {
     if (m_loop->IsInLoopThread()) {
-        m_write_buffer.Append(data, size);
-        SendInLoop();
+        SendInLoop(data, size);
     } else {
-        std::string buf(static_cast<const char *>(data), size);
-        m_loop->RunInLoop([this, buf]() {
-            this->m_write_buffer.Append(buf.data(), buf.size());
-            this->SendInLoop();
+        // Copy once into a shared block. It is queued as is in loop thread.
+        SharedBuffer buf(data, size);
+        m_loop->RunInLoop([this, buf]() mutable {
+            this->SendInLoop(std::move(buf));
         });
     }
 }
 
+void eveio::AsyncTcpConnection::AsyncSend(const struct iovec *vec,
+                                          int                 count) noexcept {
+    if (m_loop->IsInLoopThread()) {
+        SendInLoop(vec, count);
+    } else {
+        size_t total = 0;
+        for (int i = 0; i < count; ++i)
+            total += vec[i].iov_len;
+
+        // Gather into one owned block. It is queued as is in loop thread.
+        std::string buf;
+        buf.reserve(total);
+        for (int i = 0; i < count; ++i)
+            buf.append(static_cast<const char *>(vec[i].iov_base),
+                       vec[i].iov_len);
+        AsyncSend(SharedBuffer(std::move(buf)));
+    }
+}
+
+void eveio::AsyncTcpConnection::AsyncSend(std::string &&data) noexcept {
+    if (m_loop->IsInLoopThread()) {
+        size_t size = data.size();
+        if (CanWriteDirect() && !UseZeroCopy(size)) {
+            int64_t ret = WriteDirect(data.data(), size);
+            if (ret < 0 || static_cast<size_t>(ret) == size)
+                return;
+
+            auto written = static_cast<size_t>(ret);
+            QueueWrite(SharedBuffer(std::move(data)), written, size - written);
+        } else {
+            SendInLoop(SharedBuffer(std::move(data)));
+        }
+    } else {
+        AsyncSend(SharedBuffer(std::move(data)));
+    }
+}
+
+void eveio::AsyncTcpConnection::AsyncSend(std::vector<char> &&data) noexcept {
+    if (m_loop->IsInLoopThread()) {
+        size_t size = data.size();
+        if (CanWriteDirect() && !UseZeroCopy(size)) {
+            int64_t ret = WriteDirect(data.data(), size);
+            if (ret < 0 || static_cast<size_t>(ret) == size)
+                return;
+
+            auto written = static_cast<size_t>(ret);
+            QueueWrite(SharedBuffer(std::move(data)), written, size - written);
+        } else {
+            SendInLoop(SharedBuffer(std::move(data)));
+        }
+    } else {
+        AsyncSend(SharedBuffer(std::move(data)));
+    }
+}
+
+void eveio::AsyncTcpConnection::AsyncSend(const SharedBuffer &data) noexcept {
+    if (m_loop->IsInLoopThread()) {
+        SendInLoop(SharedBuffer(data));
+    } else {
+        SharedBuffer buf(data);
+        m_loop->RunInLoop([this, buf]() mutable {
+            this->SendInLoop(std::move(buf));
+        });
+    }
+}
+
+bool eveio::AsyncTcpConnection::AsyncSendFile(int     fd,
+                                              int64_t offset,
+                                              size_t  length) noexcept {
+    struct stat file_stat {};
+    if (offset < 0 || ::fstat(fd, &file_stat) < 0 ||
+        !S_ISREG(file_stat.st_mode) || file_stat.st_size < offset)
+        return false;
+
+    auto available = static_cast<uint64_t>(file_stat.st_size - offset);
+    if (length == 0) {
+        length = static_cast<size_t>(available);
+        if (length == 0)
+            return true;
+    } else if (static_cast<uint64_t>(length) > available) {
+        return false;
+    }
+
+    int file = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (file < 0)
+        return false;
+
+    if (m_loop->IsInLoopThread()) {
+        SendFileInLoop(file, offset, length);
+    } else {
+        m_loop->RunInLoop([this, file, offset, length]() {
+            this->SendFileInLoop(file, offset, length);
+        });
+    }
+    return true;
+}
+
+bool eveio::AsyncTcpConnection::SetZeroCopy(bool   on,
+                                            size_t threshold) noexcept {
+#if EVEIO_HAS_ZEROCOPY
+    // SO_ZEROCOPY could not be turned off once enabled. Keep it on and only
+    // stop using MSG_ZEROCOPY.
+    if (on && !socket::setzerocopy(m_conn.GetSocket(), true))
+        return false;
+
+    m_loop->RunInLoop([this, on, threshold]() {
+        this->m_zerocopy           = on;
+        this->m_zerocopy_threshold = threshold;
+        if (on) {
+            this->m_listener.SetErrorCallback(+[](Listener *listener) {
+                auto connection = static_cast<AsyncTcpConnection *>(
+                    listener->GetTiedObject());
+                connection->HandleZeroCopyCompletion();
+            });
+        }
+    });
+    return true;
+#else
+    (void)threshold;
+    return !on;
+#endif
+}
+
+void eveio::AsyncTcpConnection::HandleZeroCopyCompletion() noexcept {
+#if EVEIO_HAS_ZEROCOPY
+    uint32_t lo     = 0;
+    uint32_t hi     = 0;
+    bool     copied = false;
+    while (
+        socket::read_zerocopy_completion(m_conn.GetSocket(), lo, hi, copied)) {
+        // Completions are usually reported in order, but that is not
+        // guaranteed. Sequence numbers may wrap around.
+        auto done = [lo, hi](const ZeroCopyPending &pending) -> bool {
+            return (pending.seq - lo) <= (hi - lo);
+        };
+        m_zerocopy_pending.erase(std::remove_if(m_zerocopy_pending.begin(),
+                                                m_zerocopy_pending.end(),
+                                                done),
+                                 m_zerocopy_pending.end());
+
+        // The kernel had to copy the data. Zero copy only adds overhead here.
+        if (copied)
+            m_zerocopy = false;
+    }
+#endif
+}
+
+void eveio::AsyncTcpConnection::PauseReading() noexcept {
+    m_loop->RunInLoop(
+        [this]() { this->PauseReadingInLoop(READ_PAUSED_BY_USER); });
+}
+
+void eveio::AsyncTcpConnection::ResumeReading() noexcept {
+    m_loop->RunInLoop([this]() {
+        this->ResumeReadingInLoop(READ_PAUSED_BY_USER);
+        this->CheckReadBuffer();
+    });
+}
+
+void eveio::AsyncTcpConnection::CheckReadBuffer() noexcept {
+    if (m_read_buffer.Size() >= m_max_read_buffer_size) {
+        if ((m_read_paused & READ_PAUSED_BY_BUFFER_FULL) == 0) {
+            m_read_buffer_full_count += 1;
+            m_loop->GetStats().num_read_buffer_full += 1;
+            PauseReadingInLoop(READ_PAUSED_BY_BUFFER_FULL);
+        }
+    } else {
+        ResumeReadingInLoop(READ_PAUSED_BY_BUFFER_FULL);
+    }
+}
+
+bool eveio::AsyncTcpConnection::PauseReadingForMemory() noexcept {
+    // The retry finds this connection by its slot, since the connection may
+    // be destroyed meanwhile.
+    if (m_slot == ConnectionTable::INVALID_SLOT)
+        return false;
+
+    if ((m_read_paused & READ_PAUSED_BY_MEMORY) == 0) {
+        m_loop->GetStats().num_read_memory_limit += 1;
+        PauseReadingInLoop(READ_PAUSED_BY_MEMORY);
+        ScheduleMemoryRetry();
+    }
+    return true;
+}
+
+void eveio::AsyncTcpConnection::ScheduleMemoryRetry() noexcept {
+    EventLoop *loop       = m_loop;
+    uint32_t   slot       = m_slot;
+    uint32_t   generation = m_generation;
+    m_loop->RunAfter(MEMORY_RETRY_INTERVAL, [loop, slot, generation]() {
+        AsyncTcpConnection *connection =
+            loop->GetConnectionTable().Find(slot, generation);
+        if (connection == nullptr || connection->IsDestroying())
+            return;
+
+        if (BufferPool::IsAboveProcessLimit()) {
+            connection->ScheduleMemoryRetry();
+        } else {
+            connection->ResumeReadingInLoop(READ_PAUSED_BY_MEMORY);
+        }
+    });
+}
+
+void eveio::AsyncTcpConnection::PauseReadingInLoop(uint32_t reason) noexcept {
+    if (m_read_paused == 0 && m_listener.IsReading())
+        m_listener.DisableReading();
+    m_read_paused |= reason;
+}
+
+void eveio::AsyncTcpConnection::ResumeReadingInLoop(uint32_t reason) noexcept {
+    if (m_read_paused == 0)
+        return;
+
+    m_read_paused &= ~reason;
+    if (m_read_paused == 0 && !m_listener.IsReading())
+        m_listener.EnableReading();
+}
+
 void eveio::AsyncTcpConnection::Destroy() noexcept {
     if (m_is_quit.exchange(true, std::memory_order_relaxed) == false) {
-        m_loop->QueueInLoop([this]() { delete this; });
+        m_loop->QueueInLoop([this]() {
+            m_stats.OnDestroy(this);
+            if (m_destroy_hook)
+                (*m_destroy_hook)(this);
+            if (m_callbacks->close_callback)
+                m_callbacks->close_callback(this);
+
+            // Memory of plain new is also from ::operator new(), so the pool
+            // could take any connection.
+            EventLoop *loop = m_loop;
+            this->~AsyncTcpConnection();
+            loop->GetConnectionPool().Release(this,
+                                              sizeof(AsyncTcpConnection));
+        });
     }
 }
 
-void eveio::AsyncTcpConnection::HandleRead() noexcept {
-    char    buffer[4096];
-    int64_t byte_read = 0;
-    while ((byte_read = m_conn.Receive(buffer, sizeof(buffer))) > 0) {
-        m_read_buffer.Append(buffer, byte_read);
-    }
+socket_t eveio::AsyncTcpConnection::Detach(std::string &buffered) noexcept {
+    if (IsDestroying() || !IsWriteQueueEmpty() || !m_zerocopy_pending.empty())
+        return INVALID_SOCKET;
+
+    m_listener.DisableAll();
+    m_listener.Unregister();
 
-    if (m_msg_callback) {
-        m_msg_callback(this, m_read_buffer);
+    buffered      = m_read_buffer.RetrieveAsString();
+    socket_t sock = m_conn.Release();
+    Destroy();
+    return sock;
+}
+
+void eveio::AsyncTcpConnection::InjectReceived(const void *data,
+                                               size_t      size) noexcept {
+    if (size == 0 || IsDestroying())
+        return;
+
+    m_read_buffer.Append(data, size);
+    m_last_active = m_loop->GetCoarseTime();
+    if (m_callbacks->msg_callback) {
+        auto callbacks = m_callbacks;
+        auto scope     = m_stats.EnterCallback(this);
+        callbacks->msg_callback(this, m_read_buffer);
+        m_stats.LeaveCallback(this, scope);
     } else {
         m_read_buffer.Clear();
     }
 
-    int saved_errno = errno;
-    if (byte_read == 0 || (byte_read < 0 && (saved_errno == ECONNRESET ||
-                                             saved_errno == EPIPE))) {
+    CheckReadBuffer();
+}
+
+TcpConnectionCallbacks &eveio::AsyncTcpConnection::MutableCallbacks() {
+    // Also copy if the private set is pinned by a running callback.
+    if (!m_owns_callbacks || m_callbacks.use_count() > 1) {
+        m_callbacks =
+            std::make_shared<TcpConnectionCallbacks>(*m_callbacks);
+        m_owns_callbacks = true;
+    }
+
+    // The private copy was created as non-const.
+    return const_cast<TcpConnectionCallbacks &>(*m_callbacks);
+}
+
+void eveio::AsyncTcpConnection::HandleRead() noexcept {
+    // Data is read into the attached block first and the rest goes to the
+    // stack buffer, so that idle connections do not need to hold any storage.
+    char         extra[65536];
+    struct iovec vec[2];
+    size_t       total_read = 0;
+    size_t       num_reads  = 0;
+    bool         is_closed  = false;
+
+    // Leave new data in the socket while the process is out of buffer memory.
+    // TCP flow control then slows the peer down.
+    if (BufferPool::IsAboveProcessLimit() && PauseReadingForMemory())
+        return;
+
+    // Never read more than the read buffer could hold.
+    size_t budget = m_read_budget_bytes;
+    if (m_max_read_buffer_size != SIZE_MAX) {
+        size_t room = m_max_read_buffer_size -
+                      std::min(m_read_buffer.Size(), m_max_read_buffer_size);
+        budget      = std::min(budget, room);
+    }
+
+    // Stop once the budget is used up. The poller is level triggered, so the
+    // rest is read in the next loop iteration, after other connections had
+    // their turn.
+    while (total_read < budget && num_reads < m_read_budget_calls) {
+        size_t want     = budget - total_read;
+        size_t writable = std::min(m_read_buffer.Capacity(), want);
+        size_t spill    = std::min(sizeof(extra), want - writable);
+        int    count    = 0;
+        if (writable > 0) {
+            vec[count].iov_base = m_read_buffer.WritableData();
+            vec[count].iov_len  = writable;
+            ++count;
+        }
+        if (spill > 0) {
+            vec[count].iov_base = extra;
+            vec[count].iov_len  = spill;
+            ++count;
+        }
+
+        int64_t byte_read = m_conn.ReceiveV(vec, count);
+        m_stats.OnReceive(this, byte_read);
+        ++num_reads;
+        if (byte_read <= 0) {
+            is_closed = (byte_read == 0 ||
+                         (errno == ECONNRESET || errno == EPIPE));
+            break;
+        }
+
+        auto bytes = static_cast<size_t>(byte_read);
+        if (bytes <= writable) {
+            m_read_buffer.HasWritten(bytes);
+        } else {
+            m_read_buffer.HasWritten(writable);
+            m_read_buffer.Append(extra, bytes - writable);
+        }
+        total_read += bytes;
+
+        // Socket receive buffer is drained. Save the EAGAIN syscall.
+        if (bytes < writable + spill)
+            break;
+    }
+
+    if (total_read > 0) {
+        m_last_active = m_loop->GetCoarseTime();
+        if (m_callbacks->msg_callback) {
+            // Keep the callbacks alive in case they are replaced inside.
+            auto callbacks = m_callbacks;
+            auto scope     = m_stats.EnterCallback(this);
+            callbacks->msg_callback(this, m_read_buffer);
+            m_stats.LeaveCallback(this, scope);
+        } else {
+            m_read_buffer.Clear();
+        }
+    }
+
+    if (is_closed) {
         Destroy();
+        return;
+    }
+
+    CheckReadBuffer();
+}
+
+int64_t eveio::AsyncTcpConnection::WriteDirect(const void *data,
+                                                size_t      size) noexcept {
+    struct iovec vec;
+    vec.iov_base = const_cast<void *>(data);
+    vec.iov_len  = size;
+    return WriteDirect(&vec, 1, size);
+}
+
+int64_t
+eveio::AsyncTcpConnection::WriteDirect(const struct iovec *vec,
+                                       int                 count,
+                                       size_t              total) noexcept {
+    int64_t ret = m_conn.SendV(vec, count);
+    m_stats.OnSend(ret);
+    if (ret < 0) {
+        int saved_errno = errno;
+        if (saved_errno == ECONNRESET || saved_errno == EPIPE) {
+            Destroy();
+            return -1;
+        }
+        return 0;
+    }
+
+    m_last_active = m_loop->GetCoarseTime();
+    if (static_cast<size_t>(ret) == total &&
+        m_callbacks->write_complete_callback) {
+        auto callbacks = m_callbacks;
+        callbacks->write_complete_callback(this);
+    }
+    return ret;
+}
+
+void eveio::AsyncTcpConnection::SendInLoop(const void *data,
+                                           size_t      size) noexcept {
+    struct iovec vec;
+    vec.iov_base = const_cast<void *>(data);
+    vec.iov_len  = size;
+    SendInLoop(&vec, 1);
+}
+
+void eveio::AsyncTcpConnection::SendInLoop(const struct iovec *vec,
+                                           int                 count) noexcept {
+    size_t total = 0;
+    for (int i = 0; i < count; ++i)
+        total += vec[i].iov_len;
+
+    if (total == 0)
+        return;
+
+    size_t written   = 0;
+    bool   has_tried = false;
+
+    // Try to send directly from user memory if nothing is queued.
+    if (CanWriteDirect()) {
+        int64_t ret = WriteDirect(vec, count, total);
+        if (ret < 0 || static_cast<size_t>(ret) == total)
+            return;
+        written   = static_cast<size_t>(ret);
+        has_tried = true;
+    }
+
+    // Copy what is left into the write buffer.
+    size_t skip = written;
+    for (int i = 0; i < count; ++i) {
+        if (skip >= vec[i].iov_len) {
+            skip -= vec[i].iov_len;
+            continue;
+        }
+        m_write_buffer.Append(static_cast<const char *>(vec[i].iov_base) + skip,
+                              vec[i].iov_len - skip);
+        skip = 0;
+    }
+
+    const size_t remain = total - written;
+
+    // Merge with the last segment if it is also stored in the write buffer.
+    if (!IsWriteQueueEmpty() && m_write_queue.back().IsCopied()) {
+        m_write_queue.back().size += remain;
+    } else {
+        m_write_queue.push_back(WriteSegment{SharedBuffer(), 0, remain, -1});
+    }
+    m_write_queue_bytes += remain;
+
+    // Socket buffer is full if the direct write was partial.
+    if (has_tried) {
+        if (!m_listener.IsWriting())
+            m_listener.EnableWriting();
+    } else {
+        StartWrite();
+    }
+
+    CheckWaterMarks();
+}
+
+void eveio::AsyncTcpConnection::SendInLoop(SharedBuffer &&data) noexcept {
+    if (data.IsEmpty())
+        return;
+
+    const size_t size = data.Size();
+    m_write_queue.push_back(WriteSegment{std::move(data), 0, size, -1});
+    m_write_queue_bytes += size;
+    StartWrite();
+    CheckWaterMarks();
+}
+
+void eveio::AsyncTcpConnection::QueueWrite(SharedBuffer &&data,
+                                           size_t         offset,
+                                           size_t         size) noexcept {
+    m_write_queue.push_back(WriteSegment{std::move(data), offset, size, -1});
+    m_write_queue_bytes += size;
+
+    if (!m_listener.IsWriting())
+        m_listener.EnableWriting();
+
+    CheckWaterMarks();
+}
+
+void eveio::AsyncTcpConnection::SendFileInLoop(int     fd,
+                                               int64_t offset,
+                                               size_t  length) noexcept {
+    m_write_queue.push_back(WriteSegment{
+        SharedBuffer(), static_cast<size_t>(offset), length, fd});
+    m_write_queue_bytes += length;
+    StartWrite();
+    CheckWaterMarks();
+}
+
+void eveio::AsyncTcpConnection::StartWrite() noexcept {
+    if (m_auto_cork) {
+        if (!m_flush_pending) {
+            m_flush_pending = true;
+            m_loop->QueueAfterEvents(
+                +[](void *object) {
+                    auto connection = static_cast<AsyncTcpConnection *>(object);
+                    connection->m_flush_pending = false;
+                    if (!connection->m_listener.IsWriting())
+                        connection->SendInLoop();
+                },
+                this);
+        }
+    } else if (!m_listener.IsWriting()) {
+        // Otherwise the queue is flushed once the socket is writable.
+        SendInLoop();
     }
 }
 
 void eveio::AsyncTcpConnection::SendInLoop() noexcept {
-    int64_t byte_written = 0;
-    while (!m_write_buffer.IsEmpty() &&
-           (byte_written = m_conn.Send(m_write_buffer.Data<char>(),
-                                       m_write_buffer.Size())) > 0) {
-        m_write_buffer.ReadOut(byte_written);
-
-        if (m_write_buffer.IsEmpty()) {
-            m_listener.DisableWriting();
-            if (m_write_complete_callback) {
-                m_write_complete_callback(this);
+    static constexpr const int MAX_IOVEC = 64;
+
+    struct iovec vec[MAX_IOVEC];
+    int64_t      byte_written = 0;
+    bool         copy_only    = false;
+
+    while (!IsWriteQueueEmpty()) {
+        const WriteSegment &head  = m_write_queue[m_write_queue_head];
+        size_t              total = 0;
+
+        if (head.IsFile()) {
+            total        = head.size;
+            byte_written = m_conn.SendFile(
+                head.file, static_cast<int64_t>(head.offset), head.size);
+
+            // The file was truncated after the region was queued. The peer
+            // could never receive what it expects.
+            if (byte_written == 0) {
+                Destroy();
+                return;
+            }
+#if EVEIO_HAS_ZEROCOPY
+        } else if (!head.IsCopied() && !copy_only && UseZeroCopy(head.size)) {
+            total        = head.size;
+            byte_written = socket::write_zerocopy(m_conn.GetSocket(),
+                                                  head.buffer.Data() +
+                                                      head.offset,
+                                                  head.size);
+
+            // The buffer must stay alive until the kernel completes this send.
+            if (byte_written >= 0) {
+                m_zerocopy_pending.push_back(
+                    ZeroCopyPending{m_zerocopy_seq++, head.buffer});
+            } else if (errno == ENOBUFS) {
+                // Socket option memory limit reached, until some pending
+                // sends complete. Send normally for the rest of this flush
+                // and try zero copy again next time.
+                copy_only = true;
+                continue;
+            }
+#endif
+        } else {
+            // Copied segments are laid out in order in m_write_buffer. Gather
+            // memory segments until the next file region.
+            const char *copied = m_write_buffer.Data<char>();
+            int         count  = 0;
+            for (size_t i = m_write_queue_head;
+                 i < m_write_queue.size() && count < MAX_IOVEC;
+                 ++i, ++count) {
+                const WriteSegment &seg = m_write_queue[i];
+                if (seg.IsFile()) {
+                    break;
+                } else if (seg.IsCopied()) {
+                    vec[count].iov_base = const_cast<char *>(copied);
+                    copied += seg.size;
+                } else {
+                    vec[count].iov_base =
+                        const_cast<char *>(seg.buffer.Data() + seg.offset);
+                }
+                vec[count].iov_len = seg.size;
+                total += seg.size;
             }
+
+            byte_written = m_conn.SendV(vec, count);
+        }
+
+        m_stats.OnSend(byte_written);
+        if (byte_written <= 0)
+            break;
+
+        m_last_active = m_loop->GetCoarseTime();
+        ConsumeWriteQueue(static_cast<size_t>(byte_written));
+        CheckWaterMarks();
+
+        if (IsWriteQueueEmpty()) {
+            if (m_listener.IsWriting())
+                m_listener.DisableWriting();
+            if (m_callbacks->write_complete_callback) {
+                auto callbacks = m_callbacks;
+                callbacks->write_complete_callback(this);
+            }
+        } else if (static_cast<size_t>(byte_written) < total) {
+            // Socket buffer is full.
+            break;
         }
     }
 
     if (byte_written < 0) {
+        // Anything but a full socket buffer is fatal. Errors of a file
+        // region, e.g. EIO from sendfile(), would otherwise leave the socket
+        // writable and spin the loop.
         int saved_errno = errno;
-        if (saved_errno == ECONNRESET || saved_errno == EPIPE) {
+        if (saved_errno != EAGAIN && saved_errno != EWOULDBLOCK &&
+            saved_errno != EINTR) {
             Destroy();
             return;
         }
     }
 
-    if (!m_write_buffer.IsEmpty()) {
+    if (!IsWriteQueueEmpty() && !m_listener.IsWriting()) {
         m_listener.EnableWriting();
     }
+
+    CheckWaterMarks();
+}
+
+void eveio::AsyncTcpConnection::ConsumeWriteQueue(size_t size) noexcept {
+    while (size > 0 && !IsWriteQueueEmpty()) {
+        WriteSegment &seg   = m_write_queue[m_write_queue_head];
+        size_t        bytes = std::min(size, seg.size);
+
+        if (seg.IsCopied())
+            m_write_buffer.ReadOut(bytes);
+
+        seg.offset += bytes;
+        seg.size -= bytes;
+        size -= bytes;
+        m_write_queue_bytes -= bytes;
+
+        if (seg.size == 0) {
+            if (seg.IsFile()) {
+                ::close(seg.file);
+                seg.file = -1;
+            }
+            seg.buffer.Reset();
+            ++m_write_queue_head;
+        }
+    }
+
+    if (IsWriteQueueEmpty()) {
+        m_write_queue.clear();
+        m_write_queue_head = 0;
+    } else if (m_write_queue_head > m_write_queue.size() / 2) {
+        m_write_queue.erase(m_write_queue.begin(),
+                            m_write_queue.begin() +
+                                static_cast<ptrdiff_t>(m_write_queue_head));
+        m_write_queue_head = 0;
+    }
+}
+
+void eveio::AsyncTcpConnection::CheckWaterMarks() noexcept {
+    if (!m_above_high_water_mark) {
+        if (m_write_queue_bytes < m_high_water_mark)
+            return;
+
+        m_above_high_water_mark = true;
+        if (m_pause_on_high_water_mark)
+            PauseReadingInLoop(READ_PAUSED_BY_WRITE_BACKLOG);
+
+        if (m_callbacks->high_water_mark_callback) {
+            auto callbacks = m_callbacks;
+            callbacks->high_water_mark_callback(this, m_write_queue_bytes);
+        }
+    } else {
+        if (m_write_queue_bytes > m_low_water_mark)
+            return;
+
+        m_above_high_water_mark = false;
+        ResumeReadingInLoop(READ_PAUSED_BY_WRITE_BACKLOG);
+
+        if (m_callbacks->low_water_mark_callback) {
+            auto callbacks = m_callbacks;
+            callbacks->low_water_mark_callback(this, m_write_queue_bytes);
+        }
+    }
 }
@@ -0,0 +1,386 @@
+#include "eveio/AsyncUdpEndpoint.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace eveio;
+
+constexpr const size_t AsyncUdpEndpoint::MAX_COALESCED_SIZE;
+
+/// Most datagrams passed to one sendmmsg() call.
+static constexpr const size_t MAX_SEND_BATCH = 64;
+
+/// Control message space for UDP_GRO (int) or UDP_SEGMENT (uint16_t).
+static constexpr const size_t CONTROL_SIZE = CMSG_SPACE(sizeof(int));
+
+#if EVEIO_HAS_UDP_GSO
+/// Kernel limits of one UDP_SEGMENT buffer.
+static constexpr const size_t MAX_GSO_SEGMENTS = 64;
+static constexpr const size_t MAX_GSO_SIZE     = 65507;
+#endif
+
+static size_t CountSegments(size_t size, size_t segment_size) noexcept {
+    if (segment_size == 0 || size <= segment_size)
+        return 1;
+    return (size + segment_size - 1) / segment_size;
+}
+
+static InetAddr ToInetAddr(const struct sockaddr_in6 &addr) noexcept {
+    if (addr.sin6_family == AF_INET)
+        return InetAddr(reinterpret_cast<const struct sockaddr_in &>(addr));
+    return InetAddr(addr);
+}
+
+void eveio::UdpMessageBatch::Reserve(size_t count, size_t size) {
+    count = std::max(count, MAX_SEND_BATCH);
+    if (count <= iovecs.size() && size <= slot_size)
+        return;
+
+    count     = std::max(count, iovecs.size());
+    slot_size = std::max(size, slot_size);
+
+    buffer.resize(count * slot_size);
+    iovecs.resize(count);
+    addrs.resize(count);
+    datagrams.resize(count);
+    control.resize(count * CONTROL_SIZE);
+#if EVEIO_HAS_MMSG
+    headers.resize(count);
+#endif
+}
+
+eveio::AsyncUdpEndpoint::AsyncUdpEndpoint(EventLoop &loop, UdpSocket &&socket)
+    : m_loop(&loop),
+      m_socket(std::move(socket)),
+      m_listener(loop, m_socket.GetSocket()),
+      m_msg_callback(),
+      m_send_error_callback(),
+      m_batch_size(DEFAULT_BATCH_SIZE),
+      m_max_datagram_size(DEFAULT_MAX_DATAGRAM_SIZE),
+      m_max_send_queue_bytes(DEFAULT_MAX_SEND_QUEUE),
+      m_receive_offload(false),
+      m_send_data(),
+      m_send_queue(),
+      m_send_head(0),
+      m_send_queue_bytes(0),
+      m_flush_pending(false),
+      m_stats() {
+    m_listener.TieObject(this);
+
+    m_listener.SetReadCallback(+[](Listener *listener) {
+        auto endpoint =
+            static_cast<AsyncUdpEndpoint *>(listener->GetTiedObject());
+        endpoint->HandleRead();
+    });
+
+    m_listener.SetWriteCallback(+[](Listener *listener) {
+        auto endpoint =
+            static_cast<AsyncUdpEndpoint *>(listener->GetTiedObject());
+        endpoint->Flush();
+    });
+
+    m_loop->RunInLoop([this]() { this->m_listener.EnableReading(); });
+}
+
+eveio::AsyncUdpEndpoint::~AsyncUdpEndpoint() {
+    if (m_flush_pending)
+        m_loop->CancelAfterEvents(this);
+}
+
+bool eveio::AsyncUdpEndpoint::EnableReceiveOffload() noexcept {
+    if (!m_socket.SetReceiveOffload(true))
+        return false;
+
+    m_receive_offload   = true;
+    m_max_datagram_size = std::max(m_max_datagram_size, MAX_COALESCED_SIZE);
+    return true;
+}
+
+void eveio::AsyncUdpEndpoint::AsyncSendTo(const void     *data,
+                                          size_t          size,
+                                          const InetAddr &peer) {
+    AsyncSendSegments(data, size, 0, peer);
+}
+
+void eveio::AsyncUdpEndpoint::AsyncSendTo(std::string   &&data,
+                                          const InetAddr &peer) {
+    AsyncSendSegments(std::move(data), 0, peer);
+}
+
+void eveio::AsyncUdpEndpoint::AsyncSendSegments(const void     *data,
+                                                size_t          size,
+                                                size_t          segment_size,
+                                                const InetAddr &peer) {
+    if (m_loop->IsInLoopThread()) {
+        SendSegmentsInLoop(data, size, segment_size, peer);
+    } else {
+        std::string copy(static_cast<const char *>(data), size);
+        AsyncSendSegments(std::move(copy), segment_size, peer);
+    }
+}
+
+void eveio::AsyncUdpEndpoint::AsyncSendSegments(std::string   &&data,
+                                                size_t          segment_size,
+                                                const InetAddr &peer) {
+    if (m_loop->IsInLoopThread()) {
+        SendSegmentsInLoop(data.data(), data.size(), segment_size, peer);
+    } else {
+        auto shared = std::make_shared<std::string>(std::move(data));
+        m_loop->RunInLoop([this, shared, segment_size, peer]() {
+            this->SendSegmentsInLoop(
+                shared->data(), shared->size(), segment_size, peer);
+        });
+    }
+}
+
+void eveio::AsyncUdpEndpoint::HandleRead() {
+    UdpMessageBatch &batch = m_loop->GetUdpBatch();
+    batch.Reserve(m_batch_size, m_max_datagram_size);
+
+    size_t count = 0;
+
+#if EVEIO_HAS_MMSG
+    for (size_t i = 0; i < m_batch_size; ++i) {
+        struct iovec &vec = batch.iovecs[i];
+        vec.iov_base      = batch.buffer.data() + i * batch.slot_size;
+        vec.iov_len       = m_max_datagram_size;
+
+        struct msghdr &msg = batch.headers[i].msg_hdr;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_name    = &batch.addrs[i];
+        msg.msg_namelen = sizeof(struct sockaddr_in6);
+        msg.msg_iov     = &vec;
+        msg.msg_iovlen  = 1;
+        if (m_receive_offload) {
+            msg.msg_control    = batch.control.data() + i * CONTROL_SIZE;
+            msg.msg_controllen = CONTROL_SIZE;
+        }
+    }
+
+    int received = socket::recvmmsg(m_socket.GetSocket(),
+                                    batch.headers.data(),
+                                    static_cast<unsigned int>(m_batch_size));
+    if (received <= 0)
+        return;
+
+    m_stats.num_receive_calls += 1;
+    for (size_t i = 0; i < static_cast<size_t>(received); ++i) {
+        struct mmsghdr &header = batch.headers[i];
+        if (header.msg_hdr.msg_flags & MSG_TRUNC) {
+            m_stats.num_truncated += 1;
+            continue;
+        }
+
+        size_t segment_size = header.msg_len;
+#    if EVEIO_HAS_UDP_GRO
+        if (m_receive_offload) {
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&header.msg_hdr);
+            for (; cmsg != nullptr;
+                 cmsg = CMSG_NXTHDR(&header.msg_hdr, cmsg)) {
+                if (cmsg->cmsg_level == IPPROTO_UDP &&
+                    cmsg->cmsg_type == UDP_GRO) {
+                    int gso_size;
+                    std::memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+                    segment_size = static_cast<size_t>(gso_size);
+                }
+            }
+        }
+#    endif
+
+        m_stats.num_received += CountSegments(header.msg_len, segment_size);
+        batch.datagrams[count++] = UdpDatagram{
+            static_cast<const char *>(batch.iovecs[i].iov_base),
+            header.msg_len, segment_size, ToInetAddr(batch.addrs[i])};
+    }
+#else
+    // One datagram per call. Truncation could not be detected portably, so
+    // read one more byte than allowed.
+    batch.Reserve(m_batch_size, m_max_datagram_size + 1);
+    while (count < m_batch_size) {
+        char    *slot = batch.buffer.data() + count * batch.slot_size;
+        InetAddr peer;
+        int64_t  size =
+            m_socket.ReceiveFrom(slot, m_max_datagram_size + 1, peer);
+        if (size < 0)
+            break;
+
+        m_stats.num_receive_calls += 1;
+        if (static_cast<size_t>(size) > m_max_datagram_size) {
+            m_stats.num_truncated += 1;
+            continue;
+        }
+        m_stats.num_received += 1;
+        batch.datagrams[count++] = UdpDatagram{
+            slot, static_cast<size_t>(size), static_cast<size_t>(size), peer};
+    }
+#endif
+
+    if (count > 0 && m_msg_callback)
+        m_msg_callback(this, batch.datagrams.data(), count);
+}
+
+void eveio::AsyncUdpEndpoint::SendSegmentsInLoop(const void     *data,
+                                                 size_t          size,
+                                                 size_t          segment_size,
+                                                 const InetAddr &peer) {
+    if (segment_size == 0 || size <= segment_size) {
+        Enqueue(data, size, 0, peer);
+        return;
+    }
+
+    auto   bytes = static_cast<const char *>(data);
+    size_t chunk = segment_size;
+#if EVEIO_HAS_UDP_GSO
+    // Each buffer passed with UDP_SEGMENT must fit in one IP packet and be
+    // cut into a limited number of segments.
+    chunk = std::min(MAX_GSO_SEGMENTS, MAX_GSO_SIZE / segment_size);
+    chunk = std::max<size_t>(chunk, 1) * segment_size;
+#endif
+
+    for (size_t offset = 0; offset < size; offset += chunk) {
+        size_t length = std::min(chunk, size - offset);
+        Enqueue(bytes + offset, length,
+                (length > segment_size) ? segment_size : 0, peer);
+    }
+}
+
+void eveio::AsyncUdpEndpoint::Enqueue(const void     *data,
+                                      size_t          size,
+                                      size_t          segment_size,
+                                      const InetAddr &peer) {
+    if (m_send_queue_bytes + size > m_max_send_queue_bytes) {
+        m_stats.num_dropped += CountSegments(size, segment_size);
+        return;
+    }
+
+    auto bytes = static_cast<const char *>(data);
+    m_send_queue.push_back(
+        PendingDatagram{m_send_data.size(), size, segment_size, peer});
+    m_send_data.insert(m_send_data.end(), bytes, bytes + size);
+    m_send_queue_bytes += size;
+
+    // Wait for the socket to be writable if it is full.
+    if (m_flush_pending || m_listener.IsWriting())
+        return;
+
+    m_flush_pending = true;
+    m_loop->QueueAfterEvents(
+        +[](void *object) {
+            auto endpoint             = static_cast<AsyncUdpEndpoint *>(object);
+            endpoint->m_flush_pending = false;
+            endpoint->Flush();
+        },
+        this);
+}
+
+void eveio::AsyncUdpEndpoint::Flush() {
+    UdpMessageBatch &batch = m_loop->GetUdpBatch();
+    batch.Reserve(MAX_SEND_BATCH, 0);
+
+    while (m_send_head < m_send_queue.size()) {
+#if EVEIO_HAS_MMSG
+        size_t count =
+            std::min(m_send_queue.size() - m_send_head, MAX_SEND_BATCH);
+        for (size_t i = 0; i < count; ++i) {
+            PendingDatagram &datagram = m_send_queue[m_send_head + i];
+
+            struct iovec &vec = batch.iovecs[i];
+            vec.iov_base      = m_send_data.data() + datagram.offset;
+            vec.iov_len       = datagram.size;
+
+            struct msghdr &msg = batch.headers[i].msg_hdr;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_name    = datagram.peer.AsSockaddr();
+            msg.msg_namelen = static_cast<socklen_t>(
+                datagram.peer.GetAddrSize());
+            msg.msg_iov    = &vec;
+            msg.msg_iovlen = 1;
+
+#    if EVEIO_HAS_UDP_GSO
+            if (datagram.segment_size != 0) {
+                auto  segment = static_cast<uint16_t>(datagram.segment_size);
+                char *control = batch.control.data() + i * CONTROL_SIZE;
+
+                msg.msg_control    = control;
+                msg.msg_controllen = CMSG_SPACE(sizeof(segment));
+
+                struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+                cmsg->cmsg_level     = IPPROTO_UDP;
+                cmsg->cmsg_type      = UDP_SEGMENT;
+                cmsg->cmsg_len       = CMSG_LEN(sizeof(segment));
+                std::memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+            }
+#    endif
+        }
+
+        int sent = socket::sendmmsg(m_socket.GetSocket(),
+                                    batch.headers.data(),
+                                    static_cast<unsigned int>(count));
+        m_stats.num_send_calls += 1;
+#else
+        const PendingDatagram &datagram = m_send_queue[m_send_head];
+        int sent = (m_socket.SendTo(m_send_data.data() + datagram.offset,
+                                    datagram.size, datagram.peer) < 0)
+                       ? -1
+                       : 1;
+        m_stats.num_send_calls += 1;
+#endif
+
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                CompactSendQueue();
+                if (!m_listener.IsWriting())
+                    m_listener.EnableWriting();
+                return;
+            }
+
+            // The first datagram is rejected, e.g. unreachable peer, too
+            // large, no buffer space in the device queue, or segmentation
+            // offload not supported by the device. Skip it so that the rest
+            // could still be sent.
+            int      error   = errno;
+            InetAddr peer    = m_send_queue[m_send_head].peer;
+            size_t   size    = m_send_queue[m_send_head].size;
+            size_t   segment = m_send_queue[m_send_head].segment_size;
+            m_send_head += 1;
+
+            m_stats.num_send_errors += CountSegments(size, segment);
+            m_send_queue_bytes -= size;
+
+            // The callback may queue more datagrams.
+            if (m_send_error_callback)
+                m_send_error_callback(this, error, peer);
+            continue;
+        }
+
+        for (int i = 0; i < sent; ++i) {
+            const PendingDatagram &datagram = m_send_queue[m_send_head++];
+            m_stats.num_sent +=
+                CountSegments(datagram.size, datagram.segment_size);
+            m_send_queue_bytes -= datagram.size;
+        }
+    }
+
+    m_send_queue.clear();
+    m_send_data.clear();
+    m_send_head = 0;
+
+    if (m_listener.IsWriting())
+        m_listener.DisableWriting();
+}
+
+void eveio::AsyncUdpEndpoint::CompactSendQueue() {
+    if (m_send_head == 0)
+        return;
+
+    size_t offset = m_send_queue[m_send_head].offset;
+    m_send_data.erase(m_send_data.begin(),
+                      m_send_data.begin() + static_cast<ptrdiff_t>(offset));
+    m_send_queue.erase(m_send_queue.begin(),
+                       m_send_queue.begin() +
+                           static_cast<ptrdiff_t>(m_send_head));
+    for (PendingDatagram &datagram : m_send_queue)
+        datagram.offset -= offset;
+
+    m_send_head = 0;
+}
@@ -0,0 +1,132 @@
+#include "eveio/BufferPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace eveio;
+
+std::atomic_size_t eveio::BufferPool::s_process_bytes{0};
+std::atomic_size_t eveio::BufferPool::s_process_limit{0};
+
+eveio::BufferPool::~BufferPool() { Trim(); }
+
+size_t eveio::BufferPool::ClassIndex(size_t size) noexcept {
+    size_t index = 0;
+    while (index < NUM_CLASSES && ClassSize(index) < size) {
+        ++index;
+    }
+    return index;
+}
+
+char *eveio::BufferPool::Acquire(size_t    size,
+                                 Category  category,
+                                 size_t   &capacity) noexcept {
+    size_t index = ClassIndex(size);
+    char  *block = nullptr;
+
+    if (index < NUM_CLASSES) {
+        capacity = ClassSize(index);
+        if (m_free_list[index] != nullptr) {
+            FreeBlock *head    = m_free_list[index];
+            m_free_list[index] = head->next;
+            m_stats.cached_bytes -= capacity;
+            block = reinterpret_cast<char *>(head);
+        }
+    } else {
+        // Round huge blocks up to page size.
+        capacity = (size + MIN_BLOCK_SIZE - 1) & ~(MIN_BLOCK_SIZE - 1);
+    }
+
+    if (block == nullptr) {
+        // Cached blocks of other size classes only take room from live
+        // buffers under the process limit.
+        if (m_stats.cached_bytes > 0 && IsAboveProcessLimit())
+            Trim();
+
+        block = static_cast<char *>(std::malloc(capacity));
+        if (block == nullptr) {
+            capacity = 0;
+            return nullptr;
+        }
+        m_stats.num_system_alloc += 1;
+        s_process_bytes.fetch_add(capacity, std::memory_order_relaxed);
+    }
+
+    m_stats.num_acquired += 1;
+    Account(category, capacity, true);
+    return block;
+}
+
+void eveio::BufferPool::Release(char    *block,
+                                size_t   capacity,
+                                Category category) noexcept {
+    if (block == nullptr)
+        return;
+
+    Account(category, capacity, false);
+
+    size_t index = ClassIndex(capacity);
+    if (index < NUM_CLASSES && ClassSize(index) == capacity &&
+        m_stats.cached_bytes + capacity <= m_cache_limit &&
+        !IsAboveProcessLimit()) {
+        auto head          = reinterpret_cast<FreeBlock *>(block);
+        head->next         = m_free_list[index];
+        m_free_list[index] = head;
+        m_stats.cached_bytes += capacity;
+    } else {
+        std::free(block);
+        s_process_bytes.fetch_sub(capacity, std::memory_order_relaxed);
+    }
+}
+
+void eveio::BufferPool::SetCacheLimit(size_t bytes) noexcept {
+    m_cache_limit = bytes;
+
+    // Free big blocks first, they are less likely to be reused.
+    size_t index = NUM_CLASSES;
+    while (m_stats.cached_bytes > m_cache_limit && index > 0) {
+        --index;
+        while (m_stats.cached_bytes > m_cache_limit &&
+               m_free_list[index] != nullptr) {
+            FreeBlock *head    = m_free_list[index];
+            m_free_list[index] = head->next;
+            m_stats.cached_bytes -= ClassSize(index);
+            std::free(head);
+            s_process_bytes.fetch_sub(ClassSize(index),
+                                      std::memory_order_relaxed);
+        }
+    }
+}
+
+void eveio::BufferPool::Trim() noexcept {
+    for (size_t i = 0; i < NUM_CLASSES; ++i) {
+        FreeCached(i);
+    }
+}
+
+void eveio::BufferPool::FreeCached(size_t index) noexcept {
+    size_t freed = 0;
+    while (m_free_list[index] != nullptr) {
+        FreeBlock *head    = m_free_list[index];
+        m_free_list[index] = head->next;
+        std::free(head);
+        freed += ClassSize(index);
+    }
+
+    m_stats.cached_bytes -= freed;
+    s_process_bytes.fetch_sub(freed, std::memory_order_relaxed);
+}
+
+void eveio::BufferPool::Account(Category category, size_t size,
+                                bool acquire) noexcept {
+    size_t &bytes = (category == CATEGORY_READ) ? m_stats.read_buffer_bytes
+                                                : m_stats.write_buffer_bytes;
+    if (acquire) {
+        bytes += size;
+        m_stats.peak_buffer_bytes =
+            std::max(m_stats.peak_buffer_bytes,
+                     m_stats.read_buffer_bytes + m_stats.write_buffer_bytes);
+    } else {
+        bytes -= size;
+    }
+}
@@ -0,0 +1,13 @@
+#include "eveio/ConnectionStats.h"
+
+using namespace eveio;
+
+static std::atomic<const TcpTraceHooks *> trace_hooks(nullptr);
+
+void eveio::SetTcpTraceHooks(const TcpTraceHooks *hooks) noexcept {
+    trace_hooks.store(hooks, std::memory_order_release);
+}
+
+const TcpTraceHooks *eveio::GetTcpTraceHooks() noexcept {
+    return trace_hooks.load(std::memory_order_acquire);
+}
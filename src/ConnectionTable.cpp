@@ -0,0 +1,41 @@
+#include "eveio/ConnectionTable.h"
+
+using namespace eveio;
+
+uint32_t eveio::ConnectionTable::Insert(AsyncTcpConnection *conn,
+                                        uint32_t           &generation) {
+    uint32_t slot = m_free_head;
+    if (slot != INVALID_SLOT) {
+        m_free_head = m_slots[slot].next_free;
+    } else if (m_slots.size() < MAX_SLOTS) {
+        // Generation starts from 1 so that a valid handle is never 0.
+        slot = static_cast<uint32_t>(m_slots.size());
+        m_slots.push_back(Slot{nullptr, 1, INVALID_SLOT});
+    } else {
+        return INVALID_SLOT;
+    }
+
+    Slot &entry     = m_slots[slot];
+    entry.conn      = conn;
+    entry.next_free = INVALID_SLOT;
+    generation      = entry.generation;
+    m_size += 1;
+    return slot;
+}
+
+void eveio::ConnectionTable::Remove(uint32_t slot) noexcept {
+    if (slot >= m_slots.size() || m_slots[slot].conn == nullptr)
+        return;
+
+    Slot &entry = m_slots[slot];
+    entry.conn  = nullptr;
+
+    // Skip 0 when wrapping around.
+    entry.generation = (entry.generation + 1) & GENERATION_MASK;
+    if (entry.generation == 0)
+        entry.generation = 1;
+
+    entry.next_free = m_free_head;
+    m_free_head     = slot;
+    m_size -= 1;
+}
@@ -1,17 +1,38 @@
 #include "eveio/EventLoop.h"
+#include "eveio/AsyncUdpEndpoint.h"
 #include "eveio/Listener.h"
 
+#include <algorithm>
+
 using namespace eveio;
 
+namespace {
+
+std::atomic<EventLoop *> g_loops[EventLoop::MAX_LOOPS];
+
+} // namespace
+
 eveio::EventLoop::EventLoop()
     : m_poller(),
       m_is_looping(false),
       m_is_quit(false),
       m_thread_id(GetThreadID()),
+      m_index(AllocateIndex(this)),
       m_wakeup_handle(),
       m_wakeup_listener(new Listener(*this, m_wakeup_handle.GetListenHandle())),
       m_pending_func(),
-      m_pending_func_mutex() {
+      m_pending_func_mutex(),
+      m_deferred(),
+      m_running_deferred(),
+      m_coarse_time(Now()),
+      m_timers(),
+      m_timer_due(),
+      m_next_timer_id(1),
+      m_buffer_pool(),
+      m_connection_pool(),
+      m_connection_table(),
+      m_stats(),
+      m_udp_batch() {
     m_wakeup_listener->TieObject(this);
     m_wakeup_listener->SetReadCallback([](Listener *listener) {
         auto loop = static_cast<EventLoop *>(listener->GetTiedObject());
@@ -23,6 +44,31 @@ eveio::EventLoop::EventLoop()
 eveio::EventLoop::~EventLoop() {
     m_wakeup_listener->DisableAll();
     m_wakeup_listener->Unregister();
+
+    if (m_index != INVALID_INDEX)
+        g_loops[m_index].store(nullptr, std::memory_order_release);
+}
+
+UdpMessageBatch &eveio::EventLoop::GetUdpBatch() {
+    if (!m_udp_batch)
+        m_udp_batch.reset(new UdpMessageBatch);
+    return *m_udp_batch;
+}
+
+uint32_t eveio::EventLoop::AllocateIndex(EventLoop *loop) noexcept {
+    for (uint32_t i = 0; i < MAX_LOOPS; ++i) {
+        EventLoop *expected = nullptr;
+        if (g_loops[i].compare_exchange_strong(expected, loop,
+                                               std::memory_order_acq_rel))
+            return i;
+    }
+    return INVALID_INDEX;
+}
+
+EventLoop *eveio::EventLoop::FromIndex(uint32_t index) noexcept {
+    if (index >= MAX_LOOPS)
+        return nullptr;
+    return g_loops[index].load(std::memory_order_acquire);
 }
 
 void eveio::EventLoop::Loop() {
@@ -31,7 +77,18 @@ void eveio::EventLoop::Loop() {
         return;
 
     while (!m_is_quit.load(std::memory_order_relaxed)) {
-        m_poller.Poll(std::chrono::milliseconds(10000));
+        // Functions queued by the last iteration must not wait for events.
+        bool has_pending;
+        {
+            std::lock_guard<std::mutex> guard(m_pending_func_mutex);
+            has_pending = !m_pending_func.empty();
+        }
+
+        m_poller.Poll(has_pending ? std::chrono::milliseconds(0)
+                                  : GetPollTimeout());
+        m_coarse_time = Now();
+        RunDeferred();
+
         // Do pending functions.
         std::vector<std::function<void()>> pendingFuncCopy;
         {
@@ -42,7 +99,127 @@ void eveio::EventLoop::Loop() {
         for (const auto &func : pendingFuncCopy) {
             func();
         }
+        RunDeferred();
+
+        RunTimers();
+        RunDeferred();
     }
 
     m_is_looping.exchange(false, std::memory_order_relaxed);
 }
+
+void eveio::EventLoop::CancelAfterEvents(void *object) noexcept {
+    auto match = [object](const std::pair<DeferredCallback, void *> &item) {
+        return item.second == object;
+    };
+
+    m_deferred.erase(
+        std::remove_if(m_deferred.begin(), m_deferred.end(), match),
+        m_deferred.end());
+
+    // Also skip calls of the running batch.
+    for (auto &item : m_running_deferred) {
+        if (item.second == object)
+            item.first = nullptr;
+    }
+}
+
+void eveio::EventLoop::RunDeferred() noexcept {
+    // Deferred calls may queue new ones, e.g. a flush that triggers the write
+    // complete callback. Keep going until nothing is queued.
+    while (!m_deferred.empty()) {
+        m_running_deferred.swap(m_deferred);
+        for (size_t i = 0; i < m_running_deferred.size(); ++i) {
+            auto &item = m_running_deferred[i];
+            if (item.first != nullptr)
+                item.first(item.second);
+        }
+        m_running_deferred.clear();
+    }
+}
+
+int64_t eveio::EventLoop::Now() noexcept {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+EventLoop::TimerId
+eveio::EventLoop::RunAfter(std::chrono::milliseconds delay,
+                           std::function<void()>     fn) {
+    return AddTimer(delay.count(), 0, std::move(fn));
+}
+
+EventLoop::TimerId
+eveio::EventLoop::RunEvery(std::chrono::milliseconds interval,
+                           std::function<void()>     fn) {
+    int64_t ms = std::max<int64_t>(interval.count(), 1);
+    return AddTimer(ms, ms, std::move(fn));
+}
+
+EventLoop::TimerId eveio::EventLoop::AddTimer(int64_t                delay,
+                                              int64_t                interval,
+                                              std::function<void()> &&fn) {
+    TimerId id  = m_next_timer_id.fetch_add(1, std::memory_order_relaxed);
+    int64_t due = Now() + std::max<int64_t>(delay, 0);
+
+    Timer timer{interval, std::move(fn)};
+    if (IsInLoopThread()) {
+        ScheduleTimer(id, due, std::move(timer));
+    } else {
+        auto shared = std::make_shared<Timer>(std::move(timer));
+        QueueInLoop([this, id, due, shared]() {
+            this->ScheduleTimer(id, due, std::move(*shared));
+        });
+        WakeUp();
+    }
+    return id;
+}
+
+void eveio::EventLoop::ScheduleTimer(TimerId id, int64_t due, Timer &&timer) {
+    m_timer_due[id] = due;
+    m_timers.emplace(std::make_pair(due, id), std::move(timer));
+}
+
+void eveio::EventLoop::CancelTimer(TimerId id) {
+    RunInLoop([this, id]() {
+        auto it = m_timer_due.find(id);
+        if (it == m_timer_due.end())
+            return;
+
+        m_timers.erase(std::make_pair(it->second, id));
+        m_timer_due.erase(it);
+    });
+}
+
+void eveio::EventLoop::RunTimers() {
+    int64_t now = Now();
+    while (!m_timers.empty() && m_timers.begin()->first.first <= now) {
+        auto    it = m_timers.begin();
+        TimerId id = it->first.second;
+
+        // The callback may cancel this timer or add new ones, so take it out
+        // of the map first.
+        Timer timer = std::move(it->second);
+        m_timers.erase(it);
+
+        if (timer.interval == 0) {
+            m_timer_due.erase(id);
+            timer.callback();
+            continue;
+        }
+
+        timer.callback();
+        if (m_timer_due.count(id) != 0)
+            ScheduleTimer(id, now + timer.interval, std::move(timer));
+    }
+}
+
+std::chrono::milliseconds eveio::EventLoop::GetPollTimeout() const noexcept {
+    int64_t timeout = 10000;
+    if (!m_timers.empty()) {
+        int64_t wait = m_timers.begin()->first.first - Now();
+        timeout      = std::min(timeout, std::max<int64_t>(wait, 0));
+    }
+    return std::chrono::milliseconds(timeout);
+}
@@ -12,8 +12,7 @@ eveio::EventLoopThreadPool::EventLoopThreadPool(size_t num_thread) noexcept
 
 EventLoop *eveio::EventLoopThreadPool::GetNextLoop() noexcept {
     if (m_is_started.load(std::memory_order_relaxed)) {
-        return m_loops[m_next_loop.fetch_add(1, std::memory_order_relaxed) %
-                       m_loops.size()];
+        return m_loops[GetNextLoopIndex()];
     }
     return nullptr;
 }
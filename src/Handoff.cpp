@@ -0,0 +1,166 @@
+#include "eveio/Handoff.h"
+
+#include <algorithm>
+#include <cerrno>
+
+using namespace eveio;
+
+namespace {
+
+enum : uint32_t {
+    HANDOFF_MAGIC = 0x65766f31, // "evo1"
+    HANDOFF_END   = 0,
+};
+
+/// Precedes every record. Name and data follow in the same stream, and the
+/// socket is attached to the first byte of the header.
+struct HandoffHeader {
+    uint32_t magic;
+    uint32_t kind;
+    uint32_t name_size;
+    uint32_t reserved;
+    uint64_t data_size;
+};
+
+/// Largest name or data accepted from the stream.
+constexpr const uint64_t MAX_RECORD_SIZE = 1ULL << 30;
+
+} // namespace
+
+eveio::HandoffSender::HandoffSender(TcpConnection &&conn) noexcept
+    : m_conn(std::move(conn)), m_mutex() {
+    m_conn.SetNonBlock(false);
+}
+
+bool eveio::HandoffSender::SendListener(const std::string &name,
+                                        socket_t           sock) noexcept {
+    return Send(HandoffItem::KIND_LISTENER, name, sock, std::string());
+}
+
+bool eveio::HandoffSender::SendConnection(
+    const std::string &name,
+    socket_t           sock,
+    const std::string &buffered) noexcept {
+    return Send(HandoffItem::KIND_CONNECTION, name, sock, buffered);
+}
+
+bool eveio::HandoffSender::Finish() noexcept {
+    if (!Send(static_cast<HandoffItem::Kind>(HANDOFF_END), std::string(),
+              INVALID_SOCKET, std::string()))
+        return false;
+
+    // The receiver answers with one byte once it has read everything.
+    char ack = 0;
+    return m_conn.Receive(&ack, 1) == 1;
+}
+
+bool eveio::HandoffSender::Send(HandoffItem::Kind  kind,
+                                const std::string &name,
+                                socket_t           sock,
+                                const std::string &data) noexcept {
+    HandoffHeader header{};
+    header.magic     = HANDOFF_MAGIC;
+    header.kind      = static_cast<uint32_t>(kind);
+    header.name_size = static_cast<uint32_t>(name.size());
+    header.data_size = data.size();
+
+    struct iovec vec[3];
+    vec[0].iov_base = &header;
+    vec[0].iov_len  = sizeof(header);
+    vec[1].iov_base = const_cast<char *>(name.data());
+    vec[1].iov_len  = name.size();
+    vec[2].iov_base = const_cast<char *>(data.data());
+    vec[2].iov_len  = data.size();
+
+    size_t total = sizeof(header) + name.size() + data.size();
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    int64_t sent;
+    if (sock != INVALID_SOCKET) {
+        sent = socket::sendwithfd(m_conn.GetSocket(), vec, 3, sock);
+    } else {
+        sent = m_conn.SendV(vec, 3);
+    }
+
+    // A large record may be sent in several parts. The socket only rides
+    // with the first one.
+    while (sent >= 0 && static_cast<size_t>(sent) < total) {
+        auto done = static_cast<size_t>(sent);
+        for (struct iovec &v : vec) {
+            size_t skip = std::min(done, v.iov_len);
+            v.iov_base  = static_cast<char *>(v.iov_base) + skip;
+            v.iov_len -= skip;
+            done -= skip;
+        }
+
+        int64_t more = m_conn.SendV(vec, 3);
+        if (more < 0 && errno != EINTR)
+            return false;
+        sent += std::max<int64_t>(more, 0);
+    }
+    return sent >= 0;
+}
+
+eveio::HandoffReceiver::HandoffReceiver(TcpConnection &&conn) noexcept
+    : m_conn(std::move(conn)), m_is_finished(false) {
+    m_conn.SetNonBlock(false);
+}
+
+bool eveio::HandoffReceiver::Receive(HandoffItem &item) noexcept {
+    if (m_is_finished || !m_conn.IsValid())
+        return false;
+
+    HandoffHeader header{};
+    int           fd = INVALID_SOCKET;
+    if (!ReadFully(&header, sizeof(header), fd) ||
+        header.magic != HANDOFF_MAGIC || header.name_size > MAX_RECORD_SIZE ||
+        header.data_size > MAX_RECORD_SIZE) {
+        if (fd != INVALID_SOCKET)
+            socket::close(fd);
+        return false;
+    }
+
+    item.name.resize(header.name_size);
+    item.data.resize(static_cast<size_t>(header.data_size));
+    if (!ReadFully(&item.name[0], item.name.size(), fd) ||
+        !ReadFully(&item.data[0], item.data.size(), fd)) {
+        if (fd != INVALID_SOCKET)
+            socket::close(fd);
+        return false;
+    }
+
+    if (header.kind == HANDOFF_END) {
+        m_is_finished = true;
+        char ack      = 1;
+        m_conn.Send(&ack, 1);
+        return false;
+    }
+
+    if (fd == INVALID_SOCKET)
+        return false;
+
+    item.kind = static_cast<HandoffItem::Kind>(header.kind);
+    item.sock = fd;
+    return true;
+}
+
+bool eveio::HandoffReceiver::ReadFully(void  *buffer,
+                                       size_t size,
+                                       int   &fd) noexcept {
+    auto   bytes = static_cast<char *>(buffer);
+    size_t done  = 0;
+    while (done < size) {
+        int64_t ret = socket::recvwithfd(
+            m_conn.GetSocket(), bytes + done, size - done, fd);
+        if (ret == 0)
+            return false;
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        done += static_cast<size_t>(ret);
+    }
+    return true;
+}
@@ -0,0 +1,84 @@
+#include "eveio/IdleConnectionWheel.h"
+#include "eveio/AsyncTcpConnection.h"
+
+#include <algorithm>
+
+using namespace eveio;
+
+eveio::IdleConnectionWheel::IdleConnectionWheel(
+    EventLoop &loop, std::chrono::milliseconds timeout, size_t num_buckets)
+    : m_loop(&loop),
+      m_timeout(std::max<int64_t>(timeout.count(), 1)),
+      m_tick(),
+      m_last_slot(),
+      m_size(0),
+      m_num_expired(0),
+      m_buckets(std::max(num_buckets, size_t(1))),
+      m_sweeping(),
+      m_expired() {
+    int64_t count = static_cast<int64_t>(m_buckets.size());
+    m_tick        = std::max<int64_t>((m_timeout + count - 1) / count, 1);
+    m_last_slot   = SlotOf(m_loop->GetCoarseTime());
+}
+
+void eveio::IdleConnectionWheel::Add(AsyncTcpConnection *conn) {
+    int64_t now         = m_loop->GetCoarseTime();
+    conn->m_last_active = now;
+    Insert(conn, SlotOf(now + m_timeout) % m_buckets.size());
+    m_size += 1;
+}
+
+void eveio::IdleConnectionWheel::Insert(AsyncTcpConnection *conn,
+                                        size_t              bucket) {
+    auto &list          = m_buckets[bucket];
+    conn->m_idle_bucket = static_cast<uint32_t>(bucket);
+    conn->m_idle_index  = static_cast<uint32_t>(list.size());
+    list.push_back(conn);
+}
+
+void eveio::IdleConnectionWheel::Remove(AsyncTcpConnection *conn) noexcept {
+    if (conn->m_idle_bucket == INVALID_BUCKET)
+        return;
+
+    // Swap with the last one so that removal is O(1).
+    auto &list = m_buckets[conn->m_idle_bucket];
+    auto  last = list.back();
+    list[conn->m_idle_index] = last;
+    last->m_idle_index       = conn->m_idle_index;
+    list.pop_back();
+
+    conn->m_idle_bucket = INVALID_BUCKET;
+    m_size -= 1;
+}
+
+void eveio::IdleConnectionWheel::Sweep() {
+    int64_t now       = m_loop->GetCoarseTime();
+    size_t  now_slot  = SlotOf(now);
+    size_t  num_slots = std::min(now_slot - m_last_slot, m_buckets.size());
+
+    for (size_t i = 1; i <= num_slots; ++i) {
+        size_t bucket = (m_last_slot + i) % m_buckets.size();
+        m_sweeping.swap(m_buckets[bucket]);
+
+        for (AsyncTcpConnection *conn : m_sweeping) {
+            int64_t deadline = conn->m_last_active + m_timeout;
+            if (deadline <= now) {
+                conn->m_idle_bucket = INVALID_BUCKET;
+                m_expired.push_back(conn);
+                continue;
+            }
+
+            // Deadlines within the current slot are checked on next tick.
+            size_t slot = std::max(SlotOf(deadline), now_slot + 1);
+            Insert(conn, slot % m_buckets.size());
+        }
+        m_sweeping.clear();
+    }
+    m_last_slot = std::max(m_last_slot, now_slot);
+
+    m_size -= m_expired.size();
+    m_num_expired += m_expired.size();
+    for (AsyncTcpConnection *conn : m_expired)
+        conn->Destroy();
+    m_expired.clear();
+}
@@ -77,6 +77,19 @@ void eveio::InetAddr::SetIpv6ScopeID(uint32_t scopeID) noexcept {
     }
 }
 
+size_t eveio::InetAddr::Hash() const noexcept {
+    // FNV-1a over the same bytes operator== compares.
+    auto   p    = reinterpret_cast<const unsigned char *>(&m_addr6);
+    size_t size = IsIpv4() ? sizeof(m_addr4) : sizeof(m_addr6);
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+}
+
 bool eveio::InetAddr::operator==(const InetAddr &rhs) const noexcept {
     if (this == &rhs) {
         return true;
@@ -0,0 +1,52 @@
+#include "eveio/ObjectPool.h"
+
+#include <new>
+
+using namespace eveio;
+
+eveio::ObjectPool::~ObjectPool() { Trim(); }
+
+void *eveio::ObjectPool::Acquire(size_t size) {
+    if (m_object_size == 0)
+        m_object_size = size;
+
+    m_stats.num_acquired += 1;
+    if (size == m_object_size && m_free_list != nullptr) {
+        FreeObject *head = m_free_list;
+        m_free_list      = head->next;
+        m_stats.cached_objects -= 1;
+        return head;
+    }
+
+    m_stats.num_system_alloc += 1;
+    return ::operator new(size);
+}
+
+void eveio::ObjectPool::Release(void *object, size_t size) noexcept {
+    if (object == nullptr)
+        return;
+
+    if (size == m_object_size && size >= sizeof(FreeObject) &&
+        m_stats.cached_objects < m_cache_limit) {
+        auto head   = static_cast<FreeObject *>(object);
+        head->next  = m_free_list;
+        m_free_list = head;
+        m_stats.cached_objects += 1;
+    } else {
+        ::operator delete(object);
+    }
+}
+
+void eveio::ObjectPool::SetCacheLimit(size_t count) noexcept {
+    m_cache_limit = count;
+    FreeCached(count);
+}
+
+void eveio::ObjectPool::FreeCached(size_t keep) noexcept {
+    while (m_stats.cached_objects > keep) {
+        FreeObject *head = m_free_list;
+        m_free_list      = head->next;
+        m_stats.cached_objects -= 1;
+        ::operator delete(head);
+    }
+}
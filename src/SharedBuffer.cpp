@@ -0,0 +1,65 @@
+#include "eveio/SharedBuffer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+using namespace eveio;
+
+template <typename T>
+struct eveio::SharedBuffer::OwnedBlock {
+    Block base;
+    T     value;
+
+    static void Destroy(Block *block) {
+        delete reinterpret_cast<OwnedBlock *>(block);
+    }
+};
+
+eveio::SharedBuffer::SharedBuffer(const void *data, size_t size) {
+    // Header and payload share one allocation.
+    void *memory = std::malloc(sizeof(Block) + size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+
+    auto  block   = new (memory) Block;
+    char *payload = static_cast<char *>(memory) + sizeof(Block);
+
+    block->refcount.store(1, std::memory_order_relaxed);
+    block->data    = payload;
+    block->size    = size;
+    block->destroy = +[](Block *b) {
+        b->~Block();
+        std::free(b);
+    };
+
+    if (size != 0)
+        memcpy(payload, data, size);
+    m_block = block;
+}
+
+eveio::SharedBuffer::SharedBuffer(std::string &&data) {
+    auto owned = new OwnedBlock<std::string>{{}, std::move(data)};
+    owned->base.refcount.store(1, std::memory_order_relaxed);
+    owned->base.data    = owned->value.data();
+    owned->base.size    = owned->value.size();
+    owned->base.destroy = &OwnedBlock<std::string>::Destroy;
+    m_block             = &owned->base;
+}
+
+eveio::SharedBuffer::SharedBuffer(std::vector<char> &&data) {
+    auto owned = new OwnedBlock<std::vector<char>>{{}, std::move(data)};
+    owned->base.refcount.store(1, std::memory_order_relaxed);
+    owned->base.data    = owned->value.data();
+    owned->base.size    = owned->value.size();
+    owned->base.destroy = &OwnedBlock<std::vector<char>>::Destroy;
+    m_block             = &owned->base;
+}
+
+void eveio::SharedBuffer::Reset() noexcept {
+    if (m_block != nullptr &&
+        m_block->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        m_block->destroy(m_block);
+    }
+    m_block = nullptr;
+}
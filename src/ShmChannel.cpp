@@ -0,0 +1,316 @@
+#include "eveio/ShmChannel.h"
+
+#if EVEIO_HAS_SHM_RING
+
+#    include <algorithm>
+#    include <cstring>
+#    include <new>
+
+using namespace eveio;
+
+namespace {
+
+/// Start of the shared segment. Ring 0 is written by the creator and ring 1
+/// by the other side. Data of both rings follows the header.
+struct ShmSegmentHeader {
+    uint32_t       magic;
+    uint32_t       version;
+    uint64_t       ring_size;
+    ShmRingControl rings[2];
+};
+
+constexpr const uint32_t SHM_MAGIC       = 0x65766d31; // "evm1"
+constexpr const uint32_t SHM_VERSION     = 1;
+constexpr const size_t   MIN_RING_SIZE   = 4096;
+constexpr const size_t   MAX_RING_SIZE   = 1024 * 1024 * 1024;
+constexpr const size_t   NUM_HANDOFF_FDS = 3;
+
+// Positions and flags are shared between processes.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "Shared memory rings need lock free atomics.");
+
+/// Round @p size up to a power of two in [MIN_RING_SIZE, MAX_RING_SIZE].
+size_t RoundRingSize(size_t size) noexcept {
+    size_t ring_size = MIN_RING_SIZE;
+    while (ring_size < size && ring_size < MAX_RING_SIZE)
+        ring_size <<= 1;
+    return ring_size;
+}
+
+} // namespace
+
+eveio::ShmChannel::~ShmChannel() { Reset(); }
+
+eveio::ShmChannel::ShmChannel(ShmChannel &&other) noexcept {
+    *this = std::move(other);
+}
+
+ShmChannel &eveio::ShmChannel::operator=(ShmChannel &&other) noexcept {
+    if (this == &other)
+        return (*this);
+
+    Reset();
+    m_conn           = std::move(other.m_conn);
+    m_segment        = other.m_segment;
+    m_segment_size   = other.m_segment_size;
+    m_ring_size      = other.m_ring_size;
+    m_out            = other.m_out;
+    m_in             = other.m_in;
+    m_out_data       = other.m_out_data;
+    m_in_data        = other.m_in_data;
+    m_notify_fd      = other.m_notify_fd;
+    m_peer_notify_fd = other.m_peer_notify_fd;
+
+    other.m_segment        = nullptr;
+    other.m_notify_fd      = -1;
+    other.m_peer_notify_fd = -1;
+    other.Reset();
+    return (*this);
+}
+
+ShmChannel eveio::ShmChannel::Create(TcpConnection &&conn, size_t ring_size) {
+    ShmChannel channel;
+    if (!conn.IsValid())
+        return channel;
+
+    ring_size           = RoundRingSize(ring_size);
+    size_t segment_size = sizeof(ShmSegmentHeader) + 2 * ring_size;
+
+    int memfd = ::memfd_create("eveio-shm", MFD_CLOEXEC);
+    if (memfd < 0)
+        return channel;
+
+    // The file is zero filled, so all ring positions and flags start at 0.
+    if (::ftruncate(memfd, static_cast<off_t>(segment_size)) != 0 ||
+        !channel.Map(memfd, ring_size, true)) {
+        ::close(memfd);
+        return channel;
+    }
+
+    auto header       = static_cast<ShmSegmentHeader *>(channel.m_segment);
+    header->ring_size = ring_size;
+    header->version   = SHM_VERSION;
+    header->magic     = SHM_MAGIC;
+
+    int peer_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    channel.m_notify_fd      = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    channel.m_peer_notify_fd = peer_fd;
+
+    // One byte per descriptor: the segment, the eventfd of the peer and then
+    // ours, so that both sides see the same order from their own view.
+    const int fds[NUM_HANDOFF_FDS] = {memfd, peer_fd, channel.m_notify_fd};
+
+    bool sent = (peer_fd >= 0 && channel.m_notify_fd >= 0) &&
+                conn.SetNonBlock(false);
+    for (size_t i = 0; sent && i < NUM_HANDOFF_FDS; ++i) {
+        char         byte = static_cast<char>(i);
+        struct iovec vec;
+        vec.iov_base = &byte;
+        vec.iov_len  = 1;
+
+        int64_t ret = socket::sendwithfd(conn.GetSocket(), &vec, 1, fds[i]);
+        sent        = (ret == 1);
+    }
+    ::close(memfd);
+
+    if (!sent || !conn.SetNonBlock(true)) {
+        channel.Reset();
+        return channel;
+    }
+
+    channel.m_conn = std::move(conn);
+    return channel;
+}
+
+ShmChannel eveio::ShmChannel::Open(TcpConnection &&conn) {
+    ShmChannel channel;
+    if (!conn.IsValid() || !conn.SetNonBlock(false))
+        return channel;
+
+    int  fds[NUM_HANDOFF_FDS] = {-1, -1, -1};
+    bool received             = true;
+    for (size_t i = 0; received && i < NUM_HANDOFF_FDS; ++i) {
+        char    byte = 0;
+        int64_t ret  = socket::recvwithfd(conn.GetSocket(), &byte, 1, fds[i]);
+        received =
+            (ret == 1 && byte == static_cast<char>(i) && fds[i] >= 0);
+    }
+
+    struct stat st;
+    if (received && ::fstat(fds[0], &st) == 0 &&
+        static_cast<size_t>(st.st_size) >= sizeof(ShmSegmentHeader)) {
+        auto   segment_size = static_cast<size_t>(st.st_size);
+        size_t ring_size    = (segment_size - sizeof(ShmSegmentHeader)) / 2;
+
+        // Do not trust the segment before its size is checked.
+        if (ring_size == RoundRingSize(ring_size) &&
+            channel.Map(fds[0], ring_size, false)) {
+            auto header = static_cast<const ShmSegmentHeader *>(
+                channel.m_segment);
+            if (header->magic != SHM_MAGIC || header->version != SHM_VERSION ||
+                header->ring_size != ring_size)
+                channel.Reset();
+        }
+    }
+
+    if (fds[0] >= 0)
+        ::close(fds[0]);
+
+    if (!channel.IsValid() || !conn.SetNonBlock(true)) {
+        if (fds[1] >= 0)
+            ::close(fds[1]);
+        if (fds[2] >= 0)
+            ::close(fds[2]);
+        channel.Reset();
+        return channel;
+    }
+
+    channel.m_notify_fd      = fds[1];
+    channel.m_peer_notify_fd = fds[2];
+    channel.m_conn           = std::move(conn);
+    return channel;
+}
+
+size_t eveio::ShmChannel::Write(const struct iovec *vec, int count) noexcept {
+    uint64_t tail = m_out->tail.load(std::memory_order_relaxed);
+    uint64_t head = m_out->head.load(std::memory_order_acquire);
+
+    // Head is written by the peer. A head that is ahead of tail or more than
+    // one ring behind means the ring is corrupt: write nothing rather than
+    // overrunning unread data.
+    if (tail - head > m_ring_size)
+        return 0;
+
+    size_t space = m_ring_size - static_cast<size_t>(tail - head);
+    size_t mask  = m_ring_size - 1;
+
+    size_t written = 0;
+    for (int i = 0; i < count && space > 0; ++i) {
+        auto   data   = static_cast<const char *>(vec[i].iov_base);
+        size_t size   = std::min(vec[i].iov_len, space);
+        size_t offset = static_cast<size_t>(tail) & mask;
+        size_t first  = std::min(size, m_ring_size - offset);
+
+        std::memcpy(m_out_data + offset, data, first);
+        std::memcpy(m_out_data, data + first, size - first);
+
+        tail += size;
+        space -= size;
+        written += size;
+    }
+
+    if (written == 0)
+        return 0;
+
+    // Sequentially consistent store and load pair with the ones in
+    // PrepareWaitReadable() of the peer: either the peer sees the new tail,
+    // or we see that it is going to sleep.
+    m_out->tail.store(tail, std::memory_order_seq_cst);
+    if (m_out->reader_waiting.load(std::memory_order_seq_cst) != 0 &&
+        m_out->reader_waiting.exchange(0, std::memory_order_relaxed) != 0)
+        Notify(m_peer_notify_fd);
+
+    return written;
+}
+
+size_t eveio::ShmChannel::Peek(struct iovec (&vec)[2]) const noexcept {
+    uint64_t head = m_in->head.load(std::memory_order_relaxed);
+    uint64_t tail = m_in->tail.load(std::memory_order_acquire);
+
+    // Never trust the peer to stay within the ring.
+    size_t size   = std::min(static_cast<size_t>(tail - head), m_ring_size);
+    size_t offset = static_cast<size_t>(head) & (m_ring_size - 1);
+    size_t first  = std::min(size, m_ring_size - offset);
+
+    vec[0].iov_base = m_in_data + offset;
+    vec[0].iov_len  = first;
+    vec[1].iov_base = m_in_data;
+    vec[1].iov_len  = size - first;
+    return size;
+}
+
+void eveio::ShmChannel::Consume(size_t size) noexcept {
+    uint64_t head = m_in->head.load(std::memory_order_relaxed);
+    // Pairs with PrepareWaitWritable() of the peer, as in Write().
+    m_in->head.store(head + size, std::memory_order_seq_cst);
+    if (m_in->writer_waiting.load(std::memory_order_seq_cst) != 0 &&
+        m_in->writer_waiting.exchange(0, std::memory_order_relaxed) != 0)
+        Notify(m_peer_notify_fd);
+}
+
+bool eveio::ShmChannel::PrepareWaitReadable() noexcept {
+    m_in->reader_waiting.store(1, std::memory_order_seq_cst);
+    if (m_in->tail.load(std::memory_order_seq_cst) !=
+        m_in->head.load(std::memory_order_relaxed)) {
+        m_in->reader_waiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool eveio::ShmChannel::PrepareWaitWritable() noexcept {
+    m_out->writer_waiting.store(1, std::memory_order_seq_cst);
+    uint64_t head = m_out->head.load(std::memory_order_seq_cst);
+    if (m_out->tail.load(std::memory_order_relaxed) - head < m_ring_size) {
+        m_out->writer_waiting.store(0, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void eveio::ShmChannel::ClearNotification() noexcept {
+    uint64_t value = 0;
+    ssize_t  ret   = ::read(m_notify_fd, &value, sizeof(value));
+    (void)ret;
+}
+
+void eveio::ShmChannel::Notify(int fd) noexcept {
+    uint64_t value = 1;
+    ssize_t  ret   = ::write(fd, &value, sizeof(value));
+    (void)ret;
+}
+
+void eveio::ShmChannel::Reset() noexcept {
+    if (m_segment != nullptr)
+        ::munmap(m_segment, m_segment_size);
+    if (m_notify_fd >= 0)
+        ::close(m_notify_fd);
+    if (m_peer_notify_fd >= 0)
+        ::close(m_peer_notify_fd);
+
+    m_conn           = TcpConnection();
+    m_segment        = nullptr;
+    m_segment_size   = 0;
+    m_ring_size      = 0;
+    m_out            = nullptr;
+    m_in             = nullptr;
+    m_out_data       = nullptr;
+    m_in_data        = nullptr;
+    m_notify_fd      = -1;
+    m_peer_notify_fd = -1;
+}
+
+bool eveio::ShmChannel::Map(int    memfd,
+                            size_t ring_size,
+                            bool   is_creator) noexcept {
+    size_t segment_size = sizeof(ShmSegmentHeader) + 2 * ring_size;
+    void  *segment      = ::mmap(nullptr, segment_size, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED, memfd, 0);
+    if (segment == MAP_FAILED)
+        return false;
+
+    auto  header = static_cast<ShmSegmentHeader *>(segment);
+    char *data   = static_cast<char *>(segment) + sizeof(ShmSegmentHeader);
+    int   out    = is_creator ? 0 : 1;
+
+    m_segment      = segment;
+    m_segment_size = segment_size;
+    m_ring_size    = ring_size;
+    m_out          = &header->rings[out];
+    m_in           = &header->rings[1 - out];
+    m_out_data     = data + out * ring_size;
+    m_in_data      = data + (1 - out) * ring_size;
+    return true;
+}
+
+#endif // EVEIO_HAS_SHM_RING
@@ -0,0 +1,98 @@
+#include "eveio/TcpConnectionHandle.h"
+#include "eveio/AsyncTcpConnection.h"
+
+using namespace eveio;
+
+EventLoop *eveio::TcpConnectionHandle::GetLoop() const noexcept {
+    if (IsNull())
+        return nullptr;
+    return EventLoop::FromIndex(GetLoopIndex());
+}
+
+AsyncTcpConnection *eveio::TcpConnectionHandle::Get() const noexcept {
+    EventLoop *loop = GetLoop();
+    if (loop == nullptr)
+        return nullptr;
+    return loop->GetConnectionTable().Find(GetSlot(), GetGeneration());
+}
+
+bool eveio::TcpConnectionHandle::Post(
+    std::function<void(AsyncTcpConnection *)> fn) const {
+    EventLoop *loop = GetLoop();
+    if (loop == nullptr)
+        return false;
+
+    if (loop->IsInLoopThread()) {
+        AsyncTcpConnection *conn = Get();
+        if (conn == nullptr)
+            return false;
+        fn(conn);
+    } else {
+        TcpConnectionHandle handle = *this;
+        loop->QueueInLoop([handle, fn]() {
+            AsyncTcpConnection *conn = handle.Get();
+            if (conn != nullptr)
+                fn(conn);
+        });
+        loop->WakeUp();
+    }
+    return true;
+}
+
+bool eveio::TcpConnectionHandle::AsyncSend(const void *data,
+                                           size_t      size) const {
+    EventLoop *loop = GetLoop();
+    if (loop == nullptr)
+        return false;
+
+    if (loop->IsInLoopThread()) {
+        AsyncTcpConnection *conn = Get();
+        if (conn == nullptr)
+            return false;
+        conn->AsyncSend(data, size);
+        return true;
+    }
+    return AsyncSend(SharedBuffer(data, size));
+}
+
+bool eveio::TcpConnectionHandle::AsyncSend(std::string &&data) const {
+    EventLoop *loop = GetLoop();
+    if (loop == nullptr)
+        return false;
+
+    if (loop->IsInLoopThread()) {
+        AsyncTcpConnection *conn = Get();
+        if (conn == nullptr)
+            return false;
+        conn->AsyncSend(std::move(data));
+        return true;
+    }
+    return AsyncSend(SharedBuffer(std::move(data)));
+}
+
+bool eveio::TcpConnectionHandle::AsyncSend(const SharedBuffer &data) const {
+    EventLoop *loop = GetLoop();
+    if (loop == nullptr)
+        return false;
+
+    if (loop->IsInLoopThread()) {
+        AsyncTcpConnection *conn = Get();
+        if (conn == nullptr)
+            return false;
+        conn->AsyncSend(data);
+        return true;
+    }
+
+    TcpConnectionHandle handle = *this;
+    loop->QueueInLoop([handle, data]() {
+        AsyncTcpConnection *conn = handle.Get();
+        if (conn != nullptr)
+            conn->AsyncSend(data);
+    });
+    loop->WakeUp();
+    return true;
+}
+
+bool eveio::TcpConnectionHandle::Destroy() const {
+    return Post([](AsyncTcpConnection *conn) { conn->Destroy(); });
+}
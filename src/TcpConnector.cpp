@@ -0,0 +1,260 @@
+#include "eveio/TcpConnector.h"
+
+#include <cerrno>
+
+using namespace eveio;
+
+eveio::TcpConnector::TcpConnector(EventLoop      &loop,
+                                  const InetAddr &peer) noexcept
+    : m_loop(&loop),
+      m_peer(peer),
+      m_unix_peer(),
+      m_socket(INVALID_SOCKET),
+      m_listener(),
+      m_state(STATE_DISCONNECTED),
+      m_is_stopped(true),
+      m_conn_callback(),
+      m_error_callback(),
+      m_initial_delay(500),
+      m_max_delay(30000),
+      m_retry_delay(500),
+      m_connect_timeout(0),
+      m_max_attempts(0),
+      m_attempts(0),
+      m_retry_timer(0),
+      m_timeout_timer(0) {}
+
+eveio::TcpConnector::TcpConnector(EventLoop      &loop,
+                                  const UnixAddr &peer) noexcept
+    : m_loop(&loop),
+      m_peer(),
+      m_unix_peer(peer),
+      m_socket(INVALID_SOCKET),
+      m_listener(),
+      m_state(STATE_DISCONNECTED),
+      m_is_stopped(true),
+      m_conn_callback(),
+      m_error_callback(),
+      m_initial_delay(500),
+      m_max_delay(30000),
+      m_retry_delay(500),
+      m_connect_timeout(0),
+      m_max_attempts(0),
+      m_attempts(0),
+      m_retry_timer(0),
+      m_timeout_timer(0) {}
+
+eveio::TcpConnector::~TcpConnector() { CloseSocket(); }
+
+void eveio::TcpConnector::Start() {
+    std::shared_ptr<TcpConnector> self = shared_from_this();
+    m_loop->RunInLoop([self]() {
+        if (self->m_state != STATE_DISCONNECTED || self->m_retry_timer != 0)
+            return;
+
+        self->m_is_stopped  = false;
+        self->m_attempts    = 0;
+        self->m_retry_delay = self->m_initial_delay;
+        self->Connect();
+    });
+}
+
+void eveio::TcpConnector::Stop() {
+    std::shared_ptr<TcpConnector> self = shared_from_this();
+    m_loop->RunInLoop([self]() {
+        self->m_is_stopped = true;
+        self->CancelTimers();
+        if (self->m_state == STATE_CONNECTING) {
+            self->CloseSocket();
+            self->m_state = STATE_DISCONNECTED;
+        }
+    });
+}
+
+void eveio::TcpConnector::Connect() noexcept {
+    m_retry_timer = 0;
+    m_attempts += 1;
+
+    bool is_unix = m_unix_peer.IsValid();
+    if (is_unix) {
+        m_socket = socket::create(AF_UNIX, SOCK_STREAM, 0);
+    } else {
+        m_socket =
+            socket::create(m_peer.GetFamily(), SOCK_STREAM, IPPROTO_TCP);
+    }
+
+    if (m_socket == INVALID_SOCKET) {
+        HandleFailure(errno);
+        return;
+    }
+
+    const struct sockaddr *addr =
+        is_unix ? m_unix_peer.AsSockaddr() : m_peer.AsSockaddr();
+    size_t addr_size =
+        is_unix ? m_unix_peer.GetAddrSize() : m_peer.GetAddrSize();
+
+    // AF_UNIX sockets either connect at once or fail, e.g. with EAGAIN if the
+    // backlog of the server is full.
+    socket::setnonblock(m_socket, true);
+    if (!socket::connect(m_socket, addr, addr_size)) {
+        int saved_errno = errno;
+        if (saved_errno != EINPROGRESS && saved_errno != EINTR) {
+            CloseSocket();
+            HandleFailure(saved_errno);
+            return;
+        }
+    }
+
+    // Connection result is reported as writable, with SO_ERROR set on
+    // failure.
+    // The old listener may still be dispatching the event that restarted
+    // this connector. Silence it and free it once the event is handled.
+    if (m_listener) {
+        std::shared_ptr<Listener> old(m_listener.release());
+        old->SetWriteCallback(nullptr);
+        old->SetErrorCallback(nullptr);
+        m_loop->QueueInLoop([old]() {});
+    }
+
+    m_state = STATE_CONNECTING;
+    m_listener.reset(new Listener(*m_loop, m_socket));
+    m_listener->TieObject(this);
+    m_listener->SetWriteCallback(+[](Listener *listener) {
+        auto connector = static_cast<TcpConnector *>(listener->GetTiedObject());
+        connector->HandleConnected();
+    });
+    m_listener->SetErrorCallback(m_listener->GetWriteCallback());
+    m_listener->EnableWriting();
+
+    if (m_connect_timeout > 0) {
+        std::weak_ptr<TcpConnector> weak_self = shared_from_this();
+        auto on_timeout = [weak_self]() {
+            std::shared_ptr<TcpConnector> self = weak_self.lock();
+            if (self && self->m_state == STATE_CONNECTING) {
+                self->m_timeout_timer = 0;
+                self->CloseSocket();
+                self->HandleFailure(ETIMEDOUT);
+            }
+        };
+
+        m_timeout_timer = m_loop->RunAfter(
+            std::chrono::milliseconds(m_connect_timeout), on_timeout);
+    }
+}
+
+void eveio::TcpConnector::HandleConnected() noexcept {
+    // Both error and write callbacks may fire for one event.
+    if (m_state != STATE_CONNECTING)
+        return;
+
+    // The callbacks may drop the last reference to this connector while its
+    // listener is still dispatching this event. Keep it alive until the
+    // event is handled.
+    std::shared_ptr<TcpConnector> guard = shared_from_this();
+    m_loop->QueueInLoop([guard]() {});
+
+    CancelTimers();
+
+    int error = socket::getsocketerror(m_socket);
+    if (error == 0 && !m_unix_peer.IsValid()) {
+        // Connecting to a local port in the ephemeral range with nothing
+        // listening may connect the socket to itself.
+        InetAddr local;
+        InetAddr peer;
+        if (socket::getsockname(m_socket, local) &&
+            socket::getpeername(m_socket, peer) && local == peer)
+            error = ECONNREFUSED;
+    }
+
+    if (error != 0) {
+        CloseSocket();
+        HandleFailure(error);
+        return;
+    }
+
+    m_listener->DisableAll();
+    m_listener->Unregister();
+
+    // Allow Start() again, also from the connection callback.
+    socket_t sock = m_socket;
+    m_socket      = INVALID_SOCKET;
+    m_state       = STATE_DISCONNECTED;
+
+    AsyncTcpConnection *conn =
+        AsyncTcpConnection::Create(*m_loop, TcpConnection(sock));
+    if (m_conn_callback)
+        m_conn_callback(conn);
+}
+
+void eveio::TcpConnector::HandleFailure(int error) noexcept {
+    // The error callback may drop the last reference to this connector.
+    std::shared_ptr<TcpConnector> guard = shared_from_this();
+    m_state                             = STATE_DISCONNECTED;
+
+    bool will_retry = !m_is_stopped && IsRetryable(error) &&
+                      (m_max_attempts == 0 || m_attempts < m_max_attempts);
+
+    // Arm the retry before calling back, so that Start() from the error
+    // callback sees the pending retry instead of starting a second attempt.
+    // Stop() from the callback cancels it.
+    if (will_retry) {
+        std::weak_ptr<TcpConnector> weak_self = guard;
+        auto on_retry = [weak_self]() {
+            std::shared_ptr<TcpConnector> self = weak_self.lock();
+            if (self && self->m_retry_timer != 0)
+                self->Connect();
+        };
+
+        m_retry_timer = m_loop->RunAfter(
+            std::chrono::milliseconds(m_retry_delay), on_retry);
+        m_retry_delay = std::min(m_retry_delay * 2, m_max_delay);
+    }
+
+    if (m_error_callback)
+        m_error_callback(error, will_retry);
+}
+
+void eveio::TcpConnector::CloseSocket() noexcept {
+    if (m_listener) {
+        m_listener->DisableAll();
+        m_listener->Unregister();
+    }
+
+    if (m_socket != INVALID_SOCKET) {
+        socket::close(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+}
+
+void eveio::TcpConnector::CancelTimers() noexcept {
+    if (m_retry_timer != 0) {
+        m_loop->CancelTimer(m_retry_timer);
+        m_retry_timer = 0;
+    }
+
+    if (m_timeout_timer != 0) {
+        m_loop->CancelTimer(m_timeout_timer);
+        m_timeout_timer = 0;
+    }
+}
+
+bool eveio::TcpConnector::IsRetryable(int error) noexcept {
+    switch (error) {
+    case ECONNREFUSED:
+    case ECONNRESET:
+    case ECONNABORTED:
+    case ETIMEDOUT:
+    case EHOSTUNREACH:
+    case ENETUNREACH:
+    case EADDRINUSE:
+    case EADDRNOTAVAIL:
+    case EAGAIN:
+    case EMFILE:
+    case ENFILE:
+    // AF_UNIX server has not created its socket file yet.
+    case ENOENT:
+        return true;
+    default:
+        return false;
+    }
+}
@@ -2,6 +2,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <future>
 
 using namespace eveio;
 
@@ -10,31 +11,56 @@ eveio::TcpServer::TcpServer(EventLoop &loop, const InetAddr &listen_addr)
 
 eveio::TcpServer::TcpServer(EventLoop &loop, const InetAddr &listen_addr,
                             std::shared_ptr<EventLoopThreadPool> pool)
+    : TcpServer(loop,
+                std::make_shared<Acceptor>(loop, listen_addr),
+                std::move(pool)) {}
+
+eveio::TcpServer::TcpServer(EventLoop &loop, const UnixAddr &listen_addr)
+    : TcpServer(loop, listen_addr, std::make_shared<EventLoopThreadPool>()) {}
+
+eveio::TcpServer::TcpServer(EventLoop &loop, const UnixAddr &listen_addr,
+                            std::shared_ptr<EventLoopThreadPool> pool)
+    : TcpServer(loop,
+                std::make_shared<Acceptor>(loop, listen_addr),
+                std::move(pool)) {}
+
+eveio::TcpServer::TcpServer(EventLoop &loop, TcpSocket &&listen_socket)
+    : TcpServer(loop,
+                std::move(listen_socket),
+                std::make_shared<EventLoopThreadPool>()) {}
+
+eveio::TcpServer::TcpServer(EventLoop &loop, TcpSocket &&listen_socket,
+                            std::shared_ptr<EventLoopThreadPool> pool)
+    : TcpServer(loop,
+                std::make_shared<Acceptor>(loop, std::move(listen_socket)),
+                std::move(pool)) {}
+
+eveio::TcpServer::TcpServer(EventLoop                           &loop,
+                            std::shared_ptr<Acceptor>            acceptor,
+                            std::shared_ptr<EventLoopThreadPool> pool)
     : m_loop(&loop),
       m_pool(std::move(pool)),
-      m_acceptor(std::make_shared<Acceptor>(*m_loop, listen_addr)),
+      m_acceptor(std::move(acceptor)),
       m_is_started(false),
       m_conn_callback(),
       m_msg_callback(),
-      m_write_complete_callback() {
-    m_acceptor->SetNewConnectionCallback([this](TcpConnection &&conn) {
-        conn.SetNonBlock(true);
-        conn.SetKeepAlive(true);
-        EventLoop *worker = this->m_pool->GetNextLoop();
-        auto async_conn   = new AsyncTcpConnection(*worker, std::move(conn));
-
-        if (m_msg_callback)
-            async_conn->SetMessageCallback(m_msg_callback);
-
-        if (m_write_complete_callback)
-            async_conn->SetWriteCompleteCallback(m_write_complete_callback);
-
-        if (m_conn_callback)
-            m_conn_callback(async_conn);
-    });
-}
+      m_write_complete_callback(),
+      m_close_callback(),
+      m_high_water_mark_callback(),
+      m_low_water_mark_callback(),
+      m_high_water_mark(AsyncTcpConnection::DEFAULT_HIGH_WATER_MARK),
+      m_low_water_mark(AsyncTcpConnection::DEFAULT_LOW_WATER_MARK),
+      m_pause_on_high_water_mark(false),
+      m_read_budget_bytes(AsyncTcpConnection::DEFAULT_READ_BUDGET_BYTES),
+      m_read_budget_calls(AsyncTcpConnection::DEFAULT_READ_BUDGET_CALLS),
+      m_auto_cork(false),
+      m_idle_timeout(0),
+      m_loop_setups() {}
 
 eveio::TcpServer::~TcpServer() {
+    for (const auto &setup : m_loop_setups)
+        setup->is_closed.store(true, std::memory_order_relaxed);
+
     {
         std::shared_ptr<Acceptor> guard = m_acceptor;
         m_loop->RunInLoop([guard]() { guard->Quit(); });
@@ -45,12 +71,200 @@ void eveio::TcpServer::Start() {
     if (m_is_started.exchange(true, std::memory_order_relaxed))
         return;
 
-    m_loop->RunInLoop([this]() {
-        if (!m_acceptor->Listen()) {
+    // Worker loops must be ready before accepting any connection.
+    m_pool->Start();
+    const auto &loops = m_pool->GetAllLoops();
+    m_loop_setups.reserve(loops.size());
+    for (EventLoop *worker : loops) {
+        auto context   = std::make_shared<LoopContext>();
+        auto callbacks = std::make_shared<TcpConnectionCallbacks>();
+
+        callbacks->msg_callback             = m_msg_callback;
+        callbacks->write_complete_callback  = m_write_complete_callback;
+        callbacks->high_water_mark_callback = m_high_water_mark_callback;
+        callbacks->low_water_mark_callback  = m_low_water_mark_callback;
+        callbacks->close_callback           = m_close_callback;
+
+        auto setup                      = std::make_shared<LoopSetup>();
+        setup->loop                     = worker;
+        setup->context                  = context;
+        setup->callbacks                = std::move(callbacks);
+        setup->conn_callback            = m_conn_callback;
+        setup->high_water_mark          = m_high_water_mark;
+        setup->low_water_mark           = m_low_water_mark;
+        setup->read_budget_bytes        = m_read_budget_bytes;
+        setup->read_budget_calls        = m_read_budget_calls;
+        setup->pause_on_high_water_mark = m_pause_on_high_water_mark;
+        setup->auto_cork                = m_auto_cork;
+
+        // Kept out of the callback set so that handlers replacing the close
+        // callback of a connection could not skip it. The context is shared
+        // so that connections outliving the server could still unregister
+        // themselves.
+        setup->destroy_hook = std::make_shared<const TcpConnectionCallback>(
+            [context](AsyncTcpConnection *connection) {
+                context->connections.erase(connection);
+                if (context->idle_wheel)
+                    context->idle_wheel->Remove(connection);
+            });
+
+        if (m_idle_timeout.count() > 0) {
+            std::chrono::milliseconds timeout = m_idle_timeout;
+            worker->RunInLoop([worker, context, timeout]() {
+                StartIdleWheel(worker, context, timeout);
+            });
+        }
+
+        m_loop_setups.push_back(std::move(setup));
+    }
+
+    // Neither the acceptor nor the tasks it posts refer to the server, since
+    // both may outlive it.
+    std::shared_ptr<EventLoopThreadPool>    pool   = m_pool;
+    std::vector<std::shared_ptr<LoopSetup>> setups = m_loop_setups;
+    m_acceptor->SetNewConnectionCallback(
+        [pool, setups](TcpConnection &&conn) {
+            conn.SetNonBlock(true);
+            conn.SetKeepAlive(true);
+
+            // Create the connection in its own loop thread so that callbacks
+            // are set before any event of this connection is handled.
+            size_t                     index = pool->GetNextLoopIndex();
+            std::shared_ptr<LoopSetup> setup = setups[index];
+            socket_t                   sock  = conn.Release();
+            setup->loop->RunInLoop(
+                [setup, sock]() { NewConnection(*setup, sock); });
+        });
+
+    std::shared_ptr<Acceptor> acceptor = m_acceptor;
+    m_loop->RunInLoop([acceptor]() {
+        if (!acceptor->Listen()) {
             fprintf(stderr,
                     "eveio::TcpServer::Start - Acceptor failed to listen.\n");
             std::abort();
         }
     });
-    m_pool->Start();
+}
+
+AsyncTcpConnection *
+eveio::TcpServer::NewConnection(const LoopSetup &setup,
+                                socket_t         sock) noexcept {
+    if (setup.is_closed.load(std::memory_order_relaxed)) {
+        socket::close(sock);
+        return nullptr;
+    }
+
+    auto async_conn =
+        AsyncTcpConnection::Create(*setup.loop, TcpConnection(sock));
+
+    async_conn->SetCallbacks(setup.callbacks);
+    async_conn->SetDestroyHook(setup.destroy_hook);
+    async_conn->SetWaterMarks(setup.high_water_mark, setup.low_water_mark);
+    async_conn->SetPauseReadingOnHighWaterMark(setup.pause_on_high_water_mark);
+    async_conn->SetReadBudget(setup.read_budget_bytes,
+                              setup.read_budget_calls);
+    async_conn->SetAutoCork(setup.auto_cork);
+
+    LoopContext &context = *setup.context;
+    context.connections.insert(async_conn);
+    if (context.idle_wheel)
+        context.idle_wheel->Add(async_conn);
+
+    TcpConnStatsRecorder::TraceAccept(async_conn);
+    if (setup.conn_callback)
+        setup.conn_callback(async_conn);
+    return async_conn;
+}
+
+bool eveio::TcpServer::HandOffListener(HandoffSender     &sender,
+                                       const std::string &name) {
+    std::promise<bool> done;
+    m_loop->RunInLoop([this, &sender, &name, &done]() {
+        bool sent = sender.SendListener(name, m_acceptor->GetSocket());
+        if (sent)
+            m_acceptor->Quit();
+        done.set_value(sent);
+    });
+    return done.get_future().get();
+}
+
+size_t eveio::TcpServer::HandOffIdleConnections(HandoffSender     &sender,
+                                                const std::string &name) {
+    size_t count = 0;
+    for (const auto &setup : m_loop_setups) {
+        LoopContext         *context = setup->context.get();
+        std::promise<size_t> done;
+        setup->loop->RunInLoop([context, &sender, &name, &done]() {
+            // Detached connections are destroyed and erase themselves from
+            // the set.
+            std::vector<AsyncTcpConnection *> connections(
+                context->connections.begin(), context->connections.end());
+
+            size_t      num_sent = 0;
+            std::string buffered;
+            for (AsyncTcpConnection *connection : connections) {
+                socket_t sock = connection->Detach(buffered);
+                if (sock == INVALID_SOCKET)
+                    continue;
+
+                // The peer sees nothing either way. If the other process
+                // fails to take it, the connection is simply closed.
+                if (sender.SendConnection(name, sock, buffered))
+                    ++num_sent;
+                socket::close(sock);
+            }
+            done.set_value(num_sent);
+        });
+        count += done.get_future().get();
+    }
+    return count;
+}
+
+void eveio::TcpServer::AdoptConnection(TcpConnection &&conn,
+                                       std::string   &&buffered) {
+    conn.SetNonBlock(true);
+
+    size_t                     index = m_pool->GetNextLoopIndex();
+    std::shared_ptr<LoopSetup> setup = m_loop_setups[index];
+    socket_t                   sock  = conn.Release();
+    auto data = std::make_shared<std::string>(std::move(buffered));
+    setup->loop->RunInLoop([setup, sock, data]() {
+        AsyncTcpConnection *connection = NewConnection(*setup, sock);
+        if (connection != nullptr && !data->empty())
+            connection->InjectReceived(data->data(), data->size());
+    });
+}
+
+void eveio::TcpServer::Broadcast(const SharedBuffer &data) noexcept {
+    for (const auto &setup : m_loop_setups) {
+        std::shared_ptr<LoopContext> context = setup->context;
+        setup->loop->RunInLoop([context, data]() {
+            for (AsyncTcpConnection *connection : context->connections) {
+                if (!connection->IsDestroying())
+                    connection->AsyncSend(data);
+            }
+        });
+    }
+}
+
+void eveio::TcpServer::StartIdleWheel(EventLoop                   *loop,
+                                      std::shared_ptr<LoopContext> context,
+                                      std::chrono::milliseconds    timeout) {
+    context->idle_wheel.reset(new IdleConnectionWheel(*loop, timeout));
+
+    // The timer only holds a weak reference. It stops itself once the server
+    // and all of its connections are gone.
+    std::weak_ptr<LoopContext>         weak_context = context;
+    std::shared_ptr<EventLoop::TimerId> timer =
+        std::make_shared<EventLoop::TimerId>();
+    *timer = loop->RunEvery(
+        context->idle_wheel->GetTickInterval(),
+        [loop, weak_context, timer]() {
+            std::shared_ptr<LoopContext> locked = weak_context.lock();
+            if (locked) {
+                locked->idle_wheel->Sweep();
+            } else {
+                loop->CancelTimer(*timer);
+            }
+        });
 }
@@ -2,17 +2,48 @@
 
 using namespace eveio;
 
-eveio::TcpConnection::TcpConnection(const InetAddr &peer) noexcept
-    : m_socket(socket::create(peer.GetFamily(), SOCK_STREAM, IPPROTO_TCP)) {
-    if (m_socket == INVALID_SOCKET)
-        return;
+/// Create a stream socket and connect it to @p addr. Returns INVALID_SOCKET on
+/// failure.
+static socket_t ConnectTo(int                    family,
+                          int                    proto,
+                          const struct sockaddr *addr,
+                          size_t                 size) noexcept {
+    socket_t sock = socket::create(family, SOCK_STREAM, proto);
+    if (sock == INVALID_SOCKET)
+        return INVALID_SOCKET;
 
-    if (!socket::connect(m_socket, peer.AsSockaddr(), peer.GetAddrSize())) {
-        socket::close(m_socket);
-        m_socket = INVALID_SOCKET;
+    if (!socket::connect(sock, addr, size)) {
+        socket::close(sock);
+        return INVALID_SOCKET;
     }
+    return sock;
 }
 
+/// Create a stream socket and bind it to @p addr. Returns INVALID_SOCKET on
+/// failure.
+static socket_t BindTo(int                    family,
+                       const struct sockaddr *addr,
+                       size_t                 size) noexcept {
+    socket_t sock = socket::create(family, SOCK_STREAM, 0);
+    if (sock == INVALID_SOCKET)
+        return INVALID_SOCKET;
+
+    if (!socket::bind(sock, addr, size)) {
+        socket::close(sock);
+        return INVALID_SOCKET;
+    }
+    return sock;
+}
+
+eveio::TcpConnection::TcpConnection(const InetAddr &peer) noexcept
+    : m_socket(ConnectTo(peer.GetFamily(),
+                         IPPROTO_TCP,
+                         peer.AsSockaddr(),
+                         peer.GetAddrSize())) {}
+
+eveio::TcpConnection::TcpConnection(const UnixAddr &peer) noexcept
+    : m_socket(ConnectTo(AF_UNIX, 0, peer.AsSockaddr(), peer.GetAddrSize())) {}
+
 TcpConnection &eveio::TcpConnection::operator=(TcpConnection &&other) noexcept {
     if (m_socket != INVALID_SOCKET)
         socket::close(m_socket);
@@ -24,15 +55,31 @@ TcpConnection &eveio::TcpConnection::operator=(TcpConnection &&other) noexcept {
 }
 
 eveio::TcpSocket::TcpSocket(const InetAddr &addr) noexcept
-    : m_socket(socket::create(AF_INET, SOCK_STREAM, 0)) {
-    if (!socket::bind(m_socket, addr.AsSockaddr(), addr.GetAddrSize())) {
-        socket::close(m_socket);
+    : m_socket(
+          BindTo(addr.GetFamily(), addr.AsSockaddr(), addr.GetAddrSize())) {}
+
+eveio::TcpSocket::TcpSocket(const UnixAddr &addr) noexcept
+    : m_socket(BindTo(AF_UNIX, addr.AsSockaddr(), addr.GetAddrSize())) {}
+
+eveio::TcpSocket::TcpSocket(TcpSocket &&other) noexcept
+    : m_socket(other.m_socket) {
+    other.m_socket = INVALID_SOCKET;
+}
+
+TcpSocket &eveio::TcpSocket::operator=(TcpSocket &&other) noexcept {
+    if (this != &other) {
+        if (m_socket != INVALID_SOCKET)
+            socket::close(m_socket);
+
+        m_socket       = other.m_socket;
+        other.m_socket = INVALID_SOCKET;
     }
+    return (*this);
 }
 
 TcpConnection eveio::TcpSocket::Accept() noexcept {
-    struct sockaddr_in6 addr;
-    size_t              addr_size = sizeof(addr);
+    struct sockaddr_storage addr;
+    size_t                  addr_size = sizeof(addr);
     return TcpConnection{socket::accept(
         m_socket, reinterpret_cast<struct sockaddr *>(&addr), &addr_size)};
 }
@@ -0,0 +1,27 @@
+#include "eveio/UdpSocket.h"
+
+using namespace eveio;
+
+eveio::UdpSocket::UdpSocket(const InetAddr &local, bool reuse_port) noexcept
+    : m_socket(socket::create(local.GetFamily(), SOCK_DGRAM, IPPROTO_UDP)) {
+    if (m_socket == INVALID_SOCKET)
+        return;
+
+    if (!socket::setnonblock(m_socket, true) ||
+        (reuse_port && !socket::setreuseport(m_socket, true)) ||
+        !socket::bind(m_socket, local.AsSockaddr(), local.GetAddrSize())) {
+        socket::close(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+}
+
+UdpSocket &eveio::UdpSocket::operator=(UdpSocket &&other) noexcept {
+    if (this != &other) {
+        if (m_socket != INVALID_SOCKET)
+            socket::close(m_socket);
+
+        m_socket       = other.m_socket;
+        other.m_socket = INVALID_SOCKET;
+    }
+    return (*this);
+}
@@ -0,0 +1,57 @@
+#include "eveio/UnixAddr.h"
+
+#include <cstring>
+
+using namespace eveio;
+
+eveio::UnixAddr::UnixAddr(const std::string &path) noexcept {
+    // Leave room for the terminating NUL.
+    if (path.empty() || path.size() >= sizeof(m_addr.sun_path))
+        return;
+
+    m_addr.sun_family = AF_UNIX;
+    std::memcpy(m_addr.sun_path, path.data(), path.size());
+    m_size = PathOffset() + path.size() + 1;
+}
+
+UnixAddr eveio::UnixAddr::Abstract(const std::string &name) noexcept {
+    UnixAddr addr;
+#if EVEIO_OS_LINUX
+    if (name.size() + 1 > sizeof(addr.m_addr.sun_path))
+        return addr;
+
+    addr.m_addr.sun_family = AF_UNIX;
+    std::memcpy(addr.m_addr.sun_path + 1, name.data(), name.size());
+    addr.m_size = PathOffset() + name.size() + 1;
+#else
+    (void)name;
+#endif
+    return addr;
+}
+
+std::string eveio::UnixAddr::GetPath() const noexcept {
+    if (!IsValid() || m_size <= PathOffset())
+        return {};
+
+    size_t length = m_size - PathOffset();
+    if (m_addr.sun_path[0] == '\0')
+        return '@' + std::string(m_addr.sun_path + 1, length - 1);
+
+    // Filesystem paths may or may not include the terminating NUL.
+    return std::string(m_addr.sun_path, strnlen(m_addr.sun_path, length));
+}
+
+bool eveio::UnixAddr::operator==(const UnixAddr &rhs) const noexcept {
+    if (this == &rhs)
+        return true;
+
+    if (GetFamily() != rhs.GetFamily())
+        return false;
+
+    if (IsAbstract() || rhs.IsAbstract())
+        return m_size == rhs.m_size &&
+               std::memcmp(m_addr.sun_path, rhs.m_addr.sun_path,
+                           m_size - PathOffset()) == 0;
+
+    return GetPath() == rhs.GetPath();
+}
@@ -0,0 +1,220 @@
+#include "eveio/UpstreamPool.h"
+
+#include <algorithm>
+
+using namespace eveio;
+
+constexpr const std::chrono::milliseconds UpstreamPool::PREWARM_RETRY_DELAY;
+constexpr const std::chrono::milliseconds UpstreamPool::MAX_PREWARM_RETRY_DELAY;
+
+eveio::UpstreamPool::UpstreamPool(EventLoop &loop)
+    : m_loop(&loop),
+      m_min_idle(0),
+      m_max_idle(DEFAULT_MAX_IDLE),
+      m_connect_timeout(0),
+      m_upstreams(),
+      m_idle_owner(),
+      m_connectors(),
+      m_idle_callbacks(),
+      m_checkout_callbacks(std::make_shared<TcpConnectionCallbacks>()) {
+    auto callbacks = std::make_shared<TcpConnectionCallbacks>();
+
+    // An idle connection must not receive anything. Drop it if it does.
+    callbacks->msg_callback = [](AsyncTcpConnection *conn,
+                                 AsyncTcpConnBuffer &buffer) {
+        buffer.Clear();
+        conn->Destroy();
+    };
+
+    callbacks->close_callback = [this](AsyncTcpConnection *conn) {
+        this->RemoveIdle(conn);
+    };
+
+    m_idle_callbacks = std::move(callbacks);
+}
+
+eveio::UpstreamPool::~UpstreamPool() {
+    for (const auto &item : m_upstreams) {
+        if (item.second.retry_timer != 0)
+            m_loop->CancelTimer(item.second.retry_timer);
+    }
+
+    for (const auto &connector : m_connectors)
+        connector->Stop();
+
+    // Detach idle connections from this pool before they are gone.
+    for (const auto &item : m_idle_owner) {
+        item.first->SetCallbacks(m_checkout_callbacks);
+        item.first->Destroy();
+    }
+}
+
+AsyncTcpConnection *eveio::UpstreamPool::TryCheckout(const InetAddr &upstream) {
+    auto it = m_upstreams.find(upstream);
+    if (it == m_upstreams.end())
+        return nullptr;
+
+    // Most recently returned connections first, they are the warmest.
+    auto &idle = it->second.idle;
+    while (!idle.empty()) {
+        AsyncTcpConnection *conn = idle.back();
+        idle.pop_back();
+        m_idle_owner.erase(conn);
+
+        if (!conn->IsDestroying()) {
+            conn->SetCallbacks(m_checkout_callbacks);
+            Prewarm(upstream);
+            return conn;
+        }
+    }
+    return nullptr;
+}
+
+void eveio::UpstreamPool::Checkout(const InetAddr &upstream,
+                                   UpstreamCallback cb) {
+    AsyncTcpConnection *conn = TryCheckout(upstream);
+    if (conn != nullptr) {
+        cb(conn, 0);
+        return;
+    }
+
+    // Remember this upstream so that it is kept warm.
+    m_upstreams[upstream];
+    Connect(upstream, std::move(cb));
+    Prewarm(upstream);
+}
+
+void eveio::UpstreamPool::Return(AsyncTcpConnection *conn) {
+    if (conn->IsDestroying())
+        return;
+
+    InetAddr upstream;
+    if (&conn->GetLoop() != m_loop || !conn->GetReadBuffer().IsEmpty() ||
+        !conn->GetPeerAddr(upstream)) {
+        conn->Destroy();
+        return;
+    }
+
+    Upstream &entry = m_upstreams[upstream];
+    if (entry.idle.size() >= m_max_idle) {
+        conn->Destroy();
+        return;
+    }
+
+    AddIdle(upstream, conn);
+}
+
+void eveio::UpstreamPool::Prewarm(const InetAddr &upstream) {
+    Upstream &entry = m_upstreams[upstream];
+    if (entry.retry_timer != 0)
+        return;
+
+    // A connect may fail and call back before Connect() returns, so the
+    // number of attempts is fixed before starting any of them.
+    size_t have    = entry.idle.size() + entry.num_warming;
+    size_t missing = (have < m_min_idle) ? m_min_idle - have : 0;
+
+    entry.num_warming += missing;
+    for (size_t i = 0; i < missing; ++i) {
+        Connect(upstream, [this, upstream](AsyncTcpConnection *conn, int) {
+            this->OnPrewarmed(upstream, conn);
+        });
+    }
+}
+
+void eveio::UpstreamPool::OnPrewarmed(const InetAddr     &upstream,
+                                      AsyncTcpConnection *conn) {
+    Upstream &entry = m_upstreams[upstream];
+    entry.num_warming -= 1;
+
+    if (conn != nullptr) {
+        entry.retry_delay = PREWARM_RETRY_DELAY;
+        if (entry.idle.size() < m_max_idle) {
+            AddIdle(upstream, conn);
+        } else {
+            conn->Destroy();
+        }
+        return;
+    }
+
+    // Never prewarm again from inside a failure. Back off instead.
+    if (entry.retry_timer != 0)
+        return;
+
+    std::chrono::milliseconds delay = entry.retry_delay;
+    entry.retry_delay = std::min(delay * 2, MAX_PREWARM_RETRY_DELAY);
+    entry.retry_timer = m_loop->RunAfter(delay, [this, upstream]() {
+        m_upstreams[upstream].retry_timer = 0;
+        this->Prewarm(upstream);
+    });
+}
+
+size_t eveio::UpstreamPool::GetIdleCount(
+    const InetAddr &upstream) const noexcept {
+    auto it = m_upstreams.find(upstream);
+    return (it == m_upstreams.end()) ? 0 : it->second.idle.size();
+}
+
+void eveio::UpstreamPool::Connect(const InetAddr &upstream,
+                                  UpstreamCallback cb) {
+    auto connector = std::make_shared<TcpConnector>(*m_loop, upstream);
+    connector->SetRetry(std::chrono::milliseconds(0),
+                        std::chrono::milliseconds(0), 1);
+    connector->SetConnectTimeout(m_connect_timeout);
+
+    std::weak_ptr<TcpConnector> weak_connector = connector;
+    auto shared_cb = std::make_shared<UpstreamCallback>(std::move(cb));
+
+    connector->SetConnectionCallback(
+        [this, weak_connector, shared_cb](AsyncTcpConnection *conn) {
+            this->ReleaseConnector(weak_connector.lock());
+            (*shared_cb)(conn, 0);
+        });
+
+    connector->SetErrorCallback(
+        [this, weak_connector, shared_cb](int error, bool will_retry) {
+            if (will_retry)
+                return;
+            this->ReleaseConnector(weak_connector.lock());
+            (*shared_cb)(nullptr, error);
+        });
+
+    m_connectors.insert(connector);
+    connector->Start();
+}
+
+void eveio::UpstreamPool::ReleaseConnector(
+    std::shared_ptr<TcpConnector> connector) {
+    if (!connector)
+        return;
+
+    // This is called inside callbacks of the connector. Keep it alive until
+    // the current event is handled.
+    m_connectors.erase(connector);
+    m_loop->QueueInLoop([connector]() {});
+}
+
+void eveio::UpstreamPool::AddIdle(const InetAddr     &upstream,
+                                  AsyncTcpConnection *conn) {
+    conn->SetCallbacks(m_idle_callbacks);
+    conn->ResumeReading();
+    m_upstreams[upstream].idle.push_back(conn);
+    m_idle_owner[conn] = upstream;
+}
+
+void eveio::UpstreamPool::RemoveIdle(AsyncTcpConnection *conn) {
+    auto owner = m_idle_owner.find(conn);
+    if (owner == m_idle_owner.end())
+        return;
+
+    InetAddr addr     = owner->second;
+    auto     upstream = m_upstreams.find(addr);
+    if (upstream != m_upstreams.end()) {
+        auto &idle = upstream->second.idle;
+        idle.erase(std::remove(idle.begin(), idle.end(), conn), idle.end());
+    }
+    m_idle_owner.erase(owner);
+
+    // Replace the connection the peer has closed.
+    Prewarm(addr);
+}
@@ -23,6 +23,10 @@ static uint32_t MapEvent(uint32_t ep_event) noexcept {
         e |= EVENT_WRITE;
     }
 
+    if (ep_event & (EPOLLERR)) {
+        e |= EVENT_ERROR;
+    }
+
     return e;
 }
 
@@ -46,16 +50,24 @@ eveio::EPollPoller::EPollPoller()
 eveio::EPollPoller::~EPollPoller() { ::close(m_epfd); }
 
 void eveio::EPollPoller::UpdateListener(Listener &listener) {
+    // Listeners with an error callback stay registered while they listen to
+    // nothing, so that error events, e.g. MSG_ZEROCOPY completions, still
+    // arrive.
+    bool keep = !listener.IsNoneEvent() || listener.GetErrorCallback();
+
     if (listener.GetPollerState() == POLLER_STATE_INIT) {
-        if (!listener.IsNoneEvent()) {
+        if (keep) {
             listener.SetPollerState(POLLER_STATE_ADDED);
             Update(EPOLL_CTL_ADD, listener);
         }
     } else {
-        if (listener.IsNoneEvent())
+        // Listener must be added again once it listens to any event.
+        if (!keep) {
             Update(EPOLL_CTL_DEL, listener);
-        else
+            listener.SetPollerState(POLLER_STATE_INIT);
+        } else {
             Update(EPOLL_CTL_MOD, listener);
+        }
     }
 }
 
@@ -71,6 +83,12 @@ void eveio::EPollPoller::Update(int op, Listener &listener) {
     event.events   = UnmapEvent(listener.EventsListening());
     event.data.ptr = &listener;
 
+    // EPOLLERR and EPOLLHUP are always reported. Without any other event,
+    // make them edge triggered so that a hung up socket does not keep
+    // waking up the loop.
+    if (event.events == 0)
+        event.events = EPOLLET;
+
     ::epoll_ctl(m_epfd, op, listener.GetFD(), &event);
 }
 
@@ -94,6 +112,11 @@ void eveio::EPollPoller::HandleEvents(int num_events) {
         assert(listener != nullptr);
         uint32_t e = MapEvent(event.events);
 
+        if (e & EVENT_ERROR) {
+            if (listener->GetErrorCallback())
+                listener->GetErrorCallback()(listener);
+        }
+
         if (e & EVENT_READ) {
             if (listener->GetReadCallback())
                 listener->GetReadCallback()(listener);